@@ -0,0 +1,46 @@
+#ifndef _CHANGE_RATE_H_
+#define _CHANGE_RATE_H_
+
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+
+// What the crawler has seen of one page over time: when it was first and last fetched, how
+// many times it was fetched again after the first, and on how many of those refetches its
+// content had changed
+struct ChangeHistory {
+    double firstFetched = 0; // seconds since the epoch, 0 when never fetched
+    double lastFetched = 0;
+    uint32_t checks = 0;
+    uint32_t changes = 0;
+
+    void observe(double now, bool changed) {
+        if (firstFetched == 0) {
+            firstFetched = lastFetched = now;
+            return;
+        }
+        checks++;
+        changes += changed;
+        lastFetched = now;
+    }
+
+    // Changes per second, assuming changes arrive as a Poisson process. A page refetched n
+    // times, on average I seconds apart, and found changed X times changes at about
+    //     -ln((n - X + 0.5) / (n + 0.5)) / I
+    // (Cho and Garcia-Molina, "Estimating Frequency of Change"), which, unlike X / (n I),
+    // does not undercount pages that change more than once between fetches and stays finite
+    // when every fetch saw a change. A page with no refetches gets defaultRate.
+    double rate(double defaultRate) const {
+        if (checks == 0) return defaultRate;
+        double interval = std::max(1.0, (lastFetched - firstFetched) / checks);
+        return -std::log((checks - changes + 0.5) / (checks + 0.5)) / interval;
+    }
+
+    // Probability that the page has changed at least once since it was last fetched
+    double changeProbability(double now, double defaultRate) const {
+        if (firstFetched == 0) return 1;
+        return 1 - std::exp(-rate(defaultRate) * std::max(0.0, now - lastFetched));
+    }
+};
+
+#endif
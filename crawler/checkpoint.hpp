@@ -0,0 +1,397 @@
+#ifndef _CHECKPOINT_H_
+#define _CHECKPOINT_H_
+
+#include <mutex>
+#include <shared_mutex>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <functional>
+#include <string_view>
+#include <condition_variable>
+#include <unistd.h>
+
+#include "frontier.hpp"
+
+//how often the crawler's frontier is checkpointed
+#define CHECKPOINT_INTERVAL_SECONDS 30
+//the journal writer flushes at least this often, or sooner when this much is pending
+#define JOURNAL_FLUSH_MILLISECONDS 200
+#define JOURNAL_FLUSH_BYTES (1024 * 1024)
+
+#define CHECKPOINT_MAGIC "CRAWLCP3"
+
+// Everything the crawler emits (visited URLs, keywords, links, per-URL state) is appended to
+// a journal as it happens. A record is framed as
+//     u32 length | u8 type | u16 worker | payload
+// where length counts everything after itself; strings in the payload are u32 length + bytes.
+enum JournalRecordType : uint8_t {
+    RECORD_VISITED = 1,     // url
+    RECORD_KEYWORD = 2,     // keyword, url, f32 frequency
+    RECORD_LINK = 3,        // from, to
+    RECORD_URL_STATE = 4,   // url, json
+    RECORD_DUPLICATE = 5,   // url, canonical url
+    RECORD_FINGERPRINT = 6, // url, u64 simhash
+};
+
+// Builds one framed record into a reusable string
+class RecordWriter {
+private:
+    std::string& out;
+
+public:
+    RecordWriter(std::string& out, uint8_t type, uint16_t worker) : out(out) {
+        out.clear();
+        out.append(4, '\0'); // length, filled in by data()
+        out += (char) type;
+        out.append((const char*) &worker, sizeof(worker));
+    }
+
+    RecordWriter& u64(uint64_t value) {
+        out.append((const char*) &value, sizeof(value));
+        return *this;
+    }
+
+    RecordWriter& f32(float value) {
+        out.append((const char*) &value, sizeof(value));
+        return *this;
+    }
+
+    RecordWriter& str(std::string_view value) {
+        uint32_t length = value.length();
+        out.append((const char*) &length, sizeof(length));
+        out.append(value.data(), value.length());
+        return *this;
+    }
+
+    std::string_view data() {
+        uint32_t length = out.length() - 4;
+        memcpy(&out[0], &length, sizeof(length));
+        return out;
+    }
+};
+
+// Reads the fields of one record's payload; ok() turns false on a short read
+class RecordReader {
+private:
+    const char* position;
+    const char* end;
+    bool valid = true;
+
+    bool take(void* into, size_t bytes) {
+        if (!valid || (size_t)(end - position) < bytes) {
+            valid = false;
+            return false;
+        }
+        memcpy(into, position, bytes);
+        position += bytes;
+        return true;
+    }
+
+public:
+    RecordReader(const char* data, size_t length) : position(data), end(data + length) {}
+
+    uint64_t u64() {
+        uint64_t value = 0;
+        take(&value, sizeof(value));
+        return value;
+    }
+
+    uint32_t u32() {
+        uint32_t value = 0;
+        take(&value, sizeof(value));
+        return value;
+    }
+
+    float f32() {
+        float value = 0;
+        take(&value, sizeof(value));
+        return value;
+    }
+
+    double f64() {
+        double value = 0;
+        take(&value, sizeof(value));
+        return value;
+    }
+
+    std::string_view str() {
+        uint32_t length = u32();
+        if (!valid || (size_t)(end - position) < length) {
+            valid = false;
+            return std::string_view();
+        }
+        std::string_view value(position, length);
+        position += length;
+        return value;
+    }
+
+    bool ok() const {
+        return valid;
+    }
+};
+
+// Append-only journal. Workers only copy records into a pending buffer; a background thread
+// does the file writes, so the crawl never waits on the disk.
+class CrawlJournal {
+private:
+    FILE* file = nullptr;
+    std::mutex journalMutex;
+    std::condition_variable wake;
+    std::condition_variable written;
+    std::string pending;
+    std::string writing;
+    uint64_t appended = 0; // logical end of the journal, including pending bytes
+    uint64_t flushed = 0;  // bytes known to be on disk
+    bool syncRequested = false;
+    bool stopping = false;
+    std::thread writer;
+
+    void run() {
+        std::unique_lock<std::mutex> lock(journalMutex);
+        while (true) {
+            wake.wait_for(lock, std::chrono::milliseconds(JOURNAL_FLUSH_MILLISECONDS), [this] {
+                return stopping || syncRequested || pending.size() >= JOURNAL_FLUSH_BYTES;
+            });
+
+            bool sync = syncRequested;
+            syncRequested = false;
+            writing.swap(pending);
+            uint64_t target = appended;
+            lock.unlock();
+
+            if (!writing.empty()) fwrite(writing.data(), 1, writing.size(), file);
+            writing.clear();
+            fflush(file);
+            if (sync) fsync(fileno(file));
+
+            lock.lock();
+            flushed = target;
+            written.notify_all();
+            if (stopping && pending.empty()) return;
+        }
+    }
+
+public:
+    CrawlJournal() = default;
+    CrawlJournal(const CrawlJournal&) = delete;
+    CrawlJournal& operator=(const CrawlJournal&) = delete;
+
+    ~CrawlJournal() {
+        close();
+    }
+
+    // Starts a new, empty journal
+    bool open(const char* path) {
+        file = fopen(path, "wb");
+        if (file == nullptr) return false;
+        appended = flushed = 0;
+        stopping = false;
+        writer = std::thread(&CrawlJournal::run, this);
+        return true;
+    }
+
+    // Returns the journal offset just past the record
+    uint64_t append(std::string_view record) {
+        std::lock_guard<std::mutex> guard(journalMutex);
+        if (file == nullptr) return appended;
+        pending.append(record.data(), record.size());
+        appended += record.size();
+        if (pending.size() >= JOURNAL_FLUSH_BYTES) wake.notify_one();
+        return appended;
+    }
+
+    uint64_t offset() {
+        std::lock_guard<std::mutex> guard(journalMutex);
+        return appended;
+    }
+
+    // Waits until everything appended so far is on disk and returns that offset
+    uint64_t sync() {
+        std::unique_lock<std::mutex> lock(journalMutex);
+        if (file == nullptr) return appended;
+        uint64_t target = appended;
+        syncRequested = true;
+        wake.notify_one();
+        written.wait(lock, [&] { return flushed >= target; });
+        return target;
+    }
+
+    void close() {
+        {
+            std::lock_guard<std::mutex> guard(journalMutex);
+            if (file == nullptr) return;
+            stopping = true;
+            syncRequested = true;
+        }
+        wake.notify_one();
+        writer.join();
+        fclose(file);
+        file = nullptr;
+    }
+
+    // Calls fn(type, worker, offsetAfter, record, reader) for every complete record in the
+    // first `limit` bytes of a journal file. A torn record at the end is ignored.
+    static bool replay(const char* path, uint64_t limit,
+                       const std::function<void(uint8_t, uint16_t, uint64_t, std::string_view, RecordReader&)>& fn) {
+        FILE* in = fopen(path, "rb");
+        if (in == nullptr) return false;
+
+        std::string record;
+        uint64_t position = 0;
+        uint32_t length;
+        while (position + sizeof(length) <= limit && fread(&length, sizeof(length), 1, in) == 1) {
+            if (length < 3 || position + sizeof(length) + length > limit) break;
+            record.resize(sizeof(length) + length);
+            memcpy(&record[0], &length, sizeof(length));
+            if (fread(&record[sizeof(length)], 1, length, in) != length) break;
+            position += sizeof(length) + length;
+
+            uint8_t type = record[4];
+            uint16_t worker;
+            memcpy(&worker, &record[5], sizeof(worker));
+            RecordReader reader(record.data() + 7, record.size() - 7);
+            fn(type, worker, position, record, reader);
+        }
+
+        fclose(in);
+        return true;
+    }
+};
+
+// Where the crawl stood at one moment: every URL not fetched yet (with its cash and depth),
+// the page budget left for them, and how much of the journal had been written. Pages commit
+// their effects to the journal and the frontier as one step, so the records before the cut
+// are exactly those of the pages that are no longer in the frontier.
+struct CrawlCheckpoint {
+    uint64_t sitesRemaining = 0;
+    uint64_t journalCut = 0;
+    std::vector<FrontierItem> frontier;
+};
+
+// Periodically pauses page commits just long enough to snapshot the frontier and the
+// journal offset, then syncs the journal and writes the snapshot to the checkpoint file.
+// Workers hold commits() shared while they commit a page; fetching is never paused.
+class Checkpointer {
+private:
+    std::shared_mutex commitMutex;
+    std::mutex checkpointMutex;
+    std::condition_variable changed;
+    bool stopping = false;
+    std::thread thread;
+
+    static bool writeFile(const char* path, const CrawlCheckpoint& checkpoint) {
+        std::string temporary = std::string(path) + ".tmp";
+        FILE* out = fopen(temporary.c_str(), "wb");
+        if (out == nullptr) return false;
+
+        std::string bytes(CHECKPOINT_MAGIC);
+        auto u32 = [&](uint32_t v) { bytes.append((const char*) &v, sizeof(v)); };
+        auto u64 = [&](uint64_t v) { bytes.append((const char*) &v, sizeof(v)); };
+        auto f64 = [&](double v) { bytes.append((const char*) &v, sizeof(v)); };
+        auto str = [&](const std::string& s) { u32(s.length()); bytes += s; };
+
+        u64(checkpoint.sitesRemaining);
+        u64(checkpoint.journalCut);
+        u32(checkpoint.frontier.size());
+        for (const auto& item : checkpoint.frontier) {
+            str(item.url);
+            f64(item.cash);
+            u32(item.depth);
+        }
+
+        bool ok = fwrite(bytes.data(), 1, bytes.size(), out) == bytes.size();
+        ok = fflush(out) == 0 && ok;
+        ok = fsync(fileno(out)) == 0 && ok;
+        fclose(out);
+        // the rename makes the new checkpoint replace the old one atomically
+        return ok && rename(temporary.c_str(), path) == 0;
+    }
+
+    void run(CrawlJournal& journal, const char* path, int intervalSeconds,
+             const std::function<void(CrawlCheckpoint&)>& snapshot) {
+        std::unique_lock<std::mutex> lock(checkpointMutex);
+        while (true) {
+            changed.wait_for(lock, std::chrono::seconds(intervalSeconds), [this] { return stopping; });
+            if (stopping) break;
+            lock.unlock();
+
+            CrawlCheckpoint checkpoint;
+            {
+                std::unique_lock<std::shared_mutex> pause(commitMutex);
+                snapshot(checkpoint);
+                checkpoint.journalCut = journal.offset();
+            }
+            journal.sync(); // the cut is now on disk
+            if (writeFile(path, checkpoint))
+                written.fetch_add(1, std::memory_order_relaxed);
+            else
+                std::cerr << "Failed to write checkpoint " << path << std::endl;
+
+            lock.lock();
+        }
+    }
+
+public:
+    std::atomic<uint64_t> written{0};
+
+    Checkpointer() = default;
+
+    ~Checkpointer() {
+        stop();
+    }
+
+    std::shared_mutex& commits() {
+        return commitMutex;
+    }
+
+    // snapshot(checkpoint) fills in the frontier and budget while commits are paused
+    void start(CrawlJournal& journal, const char* path, std::function<void(CrawlCheckpoint&)> snapshot,
+               int intervalSeconds = CHECKPOINT_INTERVAL_SECONDS) {
+        stopping = false;
+        thread = std::thread([this, &journal, path, snapshot, intervalSeconds] {
+            run(journal, path, intervalSeconds, snapshot);
+        });
+    }
+
+    void stop() {
+        {
+            std::lock_guard<std::mutex> guard(checkpointMutex);
+            stopping = true;
+        }
+        changed.notify_all();
+        if (thread.joinable()) thread.join();
+    }
+
+    static bool read(const char* path, CrawlCheckpoint& checkpoint) {
+        FILE* in = fopen(path, "rb");
+        if (in == nullptr) return false;
+        std::string bytes;
+        char chunk[65536];
+        size_t got;
+        while ((got = fread(chunk, 1, sizeof(chunk), in)) > 0) bytes.append(chunk, got);
+        fclose(in);
+
+        size_t magic = strlen(CHECKPOINT_MAGIC);
+        if (bytes.compare(0, magic, CHECKPOINT_MAGIC) != 0) return false;
+        RecordReader reader(bytes.data() + magic, bytes.size() - magic);
+
+        checkpoint.sitesRemaining = reader.u64();
+        checkpoint.journalCut = reader.u64();
+        checkpoint.frontier.resize(reader.u32());
+        for (auto& item : checkpoint.frontier) {
+            item.url = std::string(reader.str());
+            item.cash = reader.f64();
+            item.depth = reader.u32();
+        }
+        return reader.ok();
+    }
+};
+
+#endif
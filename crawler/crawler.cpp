@@ -3,21 +3,36 @@
 #include <string.h>
 #include <cstring>
 #include <algorithm>
+#include <cmath>
+#include <limits>
 #include <sstream>
 #include <regex>
+#include <string_view>
+#include <strings.h>
 
 #include <unordered_set>
 #include <map>
 #include <queue>
+#include <deque>
 #include <set>
 
 #include "structures/queue.hpp"
 #include "../includes/structures/hashmap.hpp"
+#include "structures/buffer_pool.hpp"
+#include "structures/tokenizer.hpp"
+#include "structures/simhash.hpp"
+#include "structures/stop_words.hpp"
+#include "robots.hpp"
+#include "url_canonicalizer.hpp"
+#include "curl_share.hpp"
+#include "host_scheduler.hpp"
+#include "checkpoint.hpp"
+#include "change_rate.hpp"
+#include "sitemap.hpp"
+#include "warc.hpp"
 
 #include <curl/curl.h>
 #include <libxml/HTMLparser.h>
-#include <libxml/HTMLtree.h>
-#include <libxml/uri.h>
 
 #include <pybind11/embed.h>
 #include <fstream>
@@ -29,6 +44,7 @@
 
 //for multithreading
 #include <future>
+#include <atomic>
 #include <chrono>
 #include <thread>
 
@@ -37,94 +53,361 @@ using namespace std;
 namespace py = pybind11;
 using json = nlohmann::json;
 
-//Global queue and unordered set for bfs web crawling
+//Every URL ever queued, and those not fetched yet, handed to the workers host by host
+//in order of OPIC cash as politeness allows
 unordered_set<string> visitedURLs;
-//queue<string> urlQueue;
+HostScheduler scheduler;
+
+//URL to fetch for a queued URL whose key dropped a trailing slash or default document,
+//first form seen wins; every other URL is fetched as it is queued
+unordered_map<string, string> fetchURLs;
 
 //Keyword map
 json keyword_to_url_hashmap;
 json url_to_outgoingLinks_hashmap;
 
+//Near-duplicate pages: fingerprints of the canonical pages, and each duplicate's canonical URL
+SimHashIndex nearDuplicates;
+json duplicate_to_canonical;
+
+//Validators, keywords and links of every page from the previous crawl (read only) and this one
+json previousUrlState;
+json urlState;
+
 //mutexes
 std::mutex visitedMutex;
+std::mutex fetchURLsMutex;
 std::mutex hashmapMutex;
 std::mutex outgoingLinksMutex;
-
-//Stop words to contain
-const unordered_set<string> stopWords = {
-    "I" , "me", "my", "myself", "we", "our", "ours", "ourselves", "you", "your", "yours",
-    "yourself", "yourselves", "he", "him", "his", "himself", "she", "her", "hers", "herself",
-    "it", "its", "itself", "they", "them", "their", "theirs", "themselves", "what", "which",
-    "who", "whom", "this", "that", "these", "those", "am", "is", "are", "was", "were", "be",
-    "been", "being", "have", "has", "had", "having", "do", "does", "did", "doing", "a", "an",
-    "the", "and", "but", "if", "or", "because", "as", "until", "while", "of", "at", "by",
-    "for", "with", "about", "against", "between", "into", "through", "during", "before", "after",
-    "above", "below", "to", "from", "up", "down", "in", "out", "on", "off", "over", "under",
-    "again", "further", "then", "once", "here", "there", "when", "where", "why", "how", "all",
-    "any", "both", "each", "few", "more", "most", "other", "some", "such", "no", "nor", "not",
-    "only", "own", "same", "so", "than", "too", "very", "s", "t", "can", "will", "just",
-    "don", "should", "now" // maybe add more
+std::mutex urlStateMutex;
+std::mutex duplicatesMutex;
+
+//What conditional and compressed fetching saved this crawl
+atomic<uint64_t> pagesNotModified{0};
+atomic<uint64_t> bytesNotRefetched{0};
+atomic<uint64_t> wireBytes{0};
+atomic<uint64_t> decodedBytes{0};
+
+//Transfers aborted as soon as they turned out not to be HTML or too large, and links never queued
+atomic<uint64_t> transfersAborted{0};
+atomic<uint64_t> binaryLinksSkipped{0};
+
+//Links that only matched an already visited URL after canonicalization
+atomic<uint64_t> duplicateFetchesPrevented{0};
+
+//Refetched pages whose content had and hadn't changed since the last crawl, and what
+//--recrawl expected of the pages it picked
+atomic<uint64_t> pagesChanged{0};
+atomic<uint64_t> pagesUnchanged{0};
+uint64_t recrawlScheduled = 0;
+uint64_t recrawlCarriedOver = 0;
+double recrawlExpectedChanges = 0;
+
+//Sitemap files read and the URLs they added to the frontier
+atomic<uint64_t> sitemapsFetched{0};
+atomic<uint64_t> sitemapURLsQueued{0};
+
+//change rate assumed for a page fetched only once
+#define DEFAULT_CHANGE_INTERVAL_SECONDS (7 * 24 * 3600)
+//--recrawl leaves a page alone while the chance it has changed is below this
+#define RECRAWL_MIN_CHANGE_PROBABILITY 0.05
+
+//Journal of everything the workers emit, and periodic checkpoints of their queues, so an
+//interrupted crawl can be resumed with --resume
+#define JOURNAL_PATH "../jsonFiles/crawl.journal"
+#define CHECKPOINT_PATH "../jsonFiles/crawl.checkpoint"
+CrawlJournal journal;
+Checkpointer checkpointer;
+//index of the worker running on this thread, stamped on its journal records
+thread_local uint16_t currentWorker = 0;
+
+//Raw responses archived with --warc, and whether pages are being replayed from archives
+//with --from-warc instead of fetched
+WarcWriter warc;
+bool offline = false;
+atomic<uint64_t> recordsReplayed{0};
+
+// Download buffers shared by all workers
+BufferPool bufferPool;
+
+// robots.txt rules of every host seen so far, shared by all workers
+RobotsCache robotsCache;
+
+// DNS, TLS session and connection caches every worker's curl handle draws on
+CurlShare curlShare;
+TransferStats transferStats;
+
+//longest Crawl-delay honoured, so one host can't hold its URLs back indefinitely
+#define MAX_CRAWL_DELAY_SECONDS 30
+//workers fetching concurrently, each from a different host
+#define CRAWL_WORKERS 8
+//sitemap files read per host (index files included), once per crawl
+#define MAX_SITEMAPS_PER_HOST 64
+//cash a host's sitemap URLs share between them, as much as a seed gets
+#define SITEMAP_CASH 1.0
+//weight of a sitemap URL whose <lastmod> says it hasn't changed since last crawl fetched it
+#define SITEMAP_UNCHANGED_WEIGHT 0.1
+
+//limits that keep a page's parse state bounded no matter how large the page is
+#define MAX_PAGE_WORDS 50000
+#define MAX_WORD_LENGTH 64
+#define MAX_HEADING_TEXT 4096
+//pages (and robots.txt files) larger than this are abandoned mid-transfer
+#define MAX_PAGE_BYTES (5 * 1024 * 1024)
+//pages with fewer distinct words are too small to fingerprint reliably
+#define SIMHASH_MIN_WORDS 10
+
+//extensions of links that are never HTML and are not worth a request
+const unordered_set<string> binaryExtensions = {
+    "pdf", "ps", "doc", "docx", "xls", "xlsx", "ppt", "pptx", "odt", "rtf", "epub",
+    "jpg", "jpeg", "png", "gif", "bmp", "webp", "svg", "ico", "tif", "tiff", "avif",
+    "mp3", "wav", "ogg", "flac", "mp4", "m4v", "avi", "mov", "mkv", "webm", "wmv",
+    "zip", "gz", "tgz", "bz2", "xz", "7z", "rar", "tar", "iso", "dmg", "exe", "msi", "deb", "rpm", "apk", "bin",
+    "css", "js", "json", "woff", "woff2", "ttf", "otf", "eot"
 };
 
-// Data Structure for memory usage
-struct Node {
-    char* packetHTML;
-    int packetSize;
+// State for one page while it streams through the libxml2 push parser. Links are queued
+// as soon as their tag arrives; heading keywords are emitted once the page is complete.
+struct PageParser {
+    htmlParserCtxtPtr context = nullptr;
+    CURL* curl = nullptr;     // transfer the page arrives on, if it is being fetched
+    string fetchURL;          // URL requested, which the key in currentURL may have shortened
+    string baseURL;           // what relative links resolve against: the URL fetched, or <base href>
+    bool baseElementSeen = false;
+    const string* currentURL = nullptr;
+    vector<string> links;     // canonical URL of every link on the page, in order
+
+    int headingDepth = 0;     // > 0 while inside <title> or <h1>..<h6>
+    string headingText;       // text of the heading currently open
+    string headings;          // text of every finished heading
+
+    string pendingWord;       // word that may continue in the next text callback
+    HashMap<string, unsigned int> pageWords; // lowercase word -> occurrences
+    unsigned int totalWords = 0;
+
+    string etag;              // validators from the response, sent back on the next crawl
+    string lastModified;
+    size_t bodyBytes = 0;     // decoded bytes handed to the parser
+    uint64_t contentHash = 0xCBF29CE484222325ULL; // FNV-1a of those bytes, to tell whether the page changed
+    const char* rejected = nullptr; // why the transfer was aborted, if it was
+
+    bool archived = false;    // the response is kept for the WARC archive
+    string responseHeaders;   // its status line and headers, as the archive stores them
+    string responseBody;
+
+    uint64_t fingerprint = 0; // SimHash of the page's words, 0 when not fingerprinted
+    string duplicateOf;       // canonical URL when this page is a near-duplicate
+    json keywords = json::object(); // keyword -> frequency emitted for this page
 };
 
 // Function declarations
 
-// CALL BACK FUNCTION TO STORE HTML
-size_t storeHTML(void *packetContent, size_t size, size_t nmemb, void* node); // callback function
+// CALL BACK FUNCTIONS TO STORE OR STREAM HTML
+size_t storeHTML(void *packetContent, size_t size, size_t nmemb, void* buffer); // callback function
+size_t streamHTML(void *packetContent, size_t size, size_t nmemb, void* page); // callback function
+size_t storeHeader(char* header, size_t size, size_t nitems, void* page); // callback function
+size_t streamSitemap(void *packetContent, size_t size, size_t nmemb, void* parser); // callback function
 
 // FUNCTIONS TO CRAWL WEBPAGES AND PARSE HTML 
-void crawlWeb (const char* baseURL ); 
-char* resolveURL(const char* baseURL, const char* relativeURL);
-Node makeHTTPRequest(CURL* curl, const char* baseURL);
-void parseHTML(char* HTML, const char* baseURL, const string& currentURL, Queue<string>& urlQueue);
-void dom_traversal_and_processing(xmlNode* node, const char* baseURL , const string& currentURL,  char* HTML_Content, unsigned int *totalWords, Queue<string>& urlQueue);
-void keywordCountDOMTraversal(xmlNode *node, const char *baseURL, const string& currentURL, char* HTML_CONTENT, unsigned int *totalWords);
-string extractDomain(const string& url);
+void crawlWeb (size_t worker); 
+void setRequestOptions(CURL* curl, const char* url, size_t (*callback)(void*, size_t, size_t, void*), void* userData);
+bool makeHTTPRequest(CURL* curl, const char* baseURL, Buffer& buffer);
+bool fetchAndParsePage(CURL* curl, const FrontierItem& item, const char* baseURL);
+void beginPage(PageParser& page, const char* baseURL, const string& currentURL);
+void feedPage(PageParser& page, const char* chunk, size_t length);
+void finishPage(PageParser& page);
+void rememberPage(PageParser& page, curl_off_t downloaded, const json* previous, double fetchedAt);
+void reusePreviousCrawl(const json& previous, const string& currentURL, const char* baseURL, vector<string>& links);
+void emitPreviousPage(const json& previous, const string& currentURL);
+void keepPreviousCrawl(const string& currentURL);
+void commitLinks(const FrontierItem& item, const vector<string>& links);
+string extractOrigin(const string& url);
+
+//SAX CALLBACKS FOR THE STREAMING PARSER
+void onStartElement(void* ctx, const xmlChar* name, const xmlChar** attributes);
+void onEndElement(void* ctx, const xmlChar* name);
+void onCharacters(void* ctx, const xmlChar* text, int length);
+void onIgnoredText(void* ctx, const xmlChar* text, int length);
 
 //FUNCTIONS TO PROCESS HTML CONTENT
-void handleKeyWordsDetection(xmlNode* node, const string& currentURL, char* HTML_Content, unsigned int *totalWords);
-void handleURLDetection(xmlNode* node, const char* baseURL, const string& currentURL, Queue<string>& urlQueue);
-int getKeywordCount(string keyword, char* HTML_Content);
+void handleKeyWordsDetection(PageParser& page);
+bool isNearDuplicate(PageParser& page);
+bool recordNearDuplicate(uint64_t fingerprint, const string& currentURL, string& canonical);
+void handleURLDetection(const char* href, const char* baseURL, vector<string>& links);
+string fetchURLOf(const string& url);
+bool hasBinaryExtension(const string& url);
+unsigned int getKeywordCount(const string& keyword, PageParser& page);
 
 // FUNCTIONS TO CHECK ROBOT.TXT COMPLIANCE
-Node fetchRobotsTxt (CURL* curl, const char* baseURL);
-unordered_set<string> parseRobotsTxt (char* robotsTxtContent);
-bool isURLAllowed(const string currentURL, const unordered_set<string>& disallowedPath);
+shared_ptr<const RobotsRules> fetchRobotsRules(CURL* curl, const string& origin, Buffer& buffer);
+bool isURLAllowed(const string& currentURL, const RobotsRules& rules);
+
+// FUNCTIONS TO SEED THE FRONTIER FROM SITEMAPS
+bool claimSitemaps(const string& origin);
+void loadSitemaps(CURL* curl, const string& origin, const RobotsRules& rules);
+void queueSitemapURLs(const string& origin, const RobotsRules& rules, const vector<SitemapEntry>& entries);
 
 //FUNCTIONS TO PROCESS KEYWORDS EXTRACTION
-vector<string> processKeyWords(string text);
-//void handleURLDetection(xmlNode* node, const char* baseURL);
-void getTotalWordCount(xmlNode *node, unsigned int *totalWords);
-unsigned int countWords(const string &text);
+vector<string> processKeyWords(const string& text);
+void addPageWord(PageParser& page);
 
 //removes duplicate URLs from output
 void removeDuplicates(json& j);
 
+//FUNCTIONS TO CHECKPOINT AND RESUME A CRAWL
+RecordWriter journalRecord(JournalRecordType type);
+bool resumeCrawl();
+
+//FUNCTIONS TO REPROCESS ARCHIVED PAGES
+bool replayWarc(const char* path, size_t workers);
+void replayRecord(const WarcRecord& record);
+
+//FUNCTIONS TO REFRESH A PREVIOUS CRAWL
+double secondsSinceEpoch();
+ChangeHistory readChangeHistory(const json& state);
+void writeChangeHistory(json& state, const ChangeHistory& history);
+bool planRecrawl(uint64_t pages);
+
+//times the tokenizer against the stringstream/regex splitting it replaced
+int benchmarkTokenizer(const char* path);
+//replays a crawled link graph to compare how much of its PageRank BFS and OPIC fetch
+int evaluateFrontier(const char* path, const char* seed, size_t budget);
+
 py::scoped_interpreter guard{};
 
 py::module lemmatizer = py::module::import("lemmatizer");
-py::object lemmatize_word = lemmatizer.attr("lemmatize_word");
+py::object lemmatize_words = lemmatizer.attr("lemmatize_words");
 
-//maximum number of websites each thread will crawl
+//maximum number of websites crawled per seed URL
 #define MAX_SITES 5000
 
-int main()
+int main(int argc, char* argv[])
 {
-    py::gil_scoped_release release;
+    // ./crawler --bench-tokenizer <text or html file>
+    if (argc >= 3 && string(argv[1]) == "--bench-tokenizer")
+        return benchmarkTokenizer(argv[2]);
+
+    // ./crawler --eval-frontier <url_state.json> <seed URL> <pages>
+    if (argc >= 5 && string(argv[1]) == "--eval-frontier")
+        return evaluateFrontier(argv[2], argv[3], stoul(argv[4]));
+
+    // ./crawler --near-duplicate-distance <bits>
+    for (int i = 1; i + 1 < argc; i++)
+        if (string(argv[i]) == "--near-duplicate-distance")
+            nearDuplicates.setMaxDistance(stoi(argv[i + 1]));
+
+    // ./crawler --resume continues the crawl recorded in the last checkpoint
+    bool resume = false;
+    for (int i = 1; i < argc; i++)
+        if (string(argv[i]) == "--resume")
+            resume = true;
+
+    // ./crawler --recrawl <pages> refetches only the pages of the last crawl most likely to
+    // have changed, at most <pages> requests in all
+    uint64_t recrawlPages = 0;
+    for (int i = 1; i + 1 < argc; i++)
+        if (string(argv[i]) == "--recrawl")
+            recrawlPages = stoull(argv[i + 1]);
+
+    // ./crawler --warc <archive.warc.zst> also archives every page it fetches;
+    // ./crawler --from-warc <archive.warc.zst>... reprocesses archived pages instead of crawling
+    const char* warcOutput = nullptr;
+    vector<const char*> warcInputs;
+    for (int i = 1; i < argc; i++) {
+        if (string(argv[i]) == "--warc" && i + 1 < argc)
+            warcOutput = argv[++i];
+        else if (string(argv[i]) == "--from-warc")
+            while (i + 1 < argc && strncmp(argv[i + 1], "--", 2) != 0)
+                warcInputs.push_back(argv[++i]);
+    }
+    offline = !warcInputs.empty();
+
+    // ./crawler --workers <count> --host-delay <seconds>
+    // A replay is bound by the CPU rather than by hosts, so it uses every core by default
+    size_t workers = offline ? max(1u, thread::hardware_concurrency()) : CRAWL_WORKERS;
+    SchedulerOptions politeness;
+    politeness.maxCrawlDelay = MAX_CRAWL_DELAY_SECONDS;
+    for (int i = 1; i + 1 < argc; i++) {
+        if (string(argv[i]) == "--workers")
+            workers = max(1, stoi(argv[i + 1]));
+        else if (string(argv[i]) == "--host-delay")
+            politeness.hostDelay = stod(argv[i + 1]);
+    }
+    scheduler.setOptions(politeness);
+
+    // Validators from the last crawl let unchanged pages come back as 304s
+    ifstream stateFile("../jsonFiles/url_state.json");
+    if (stateFile)
+        previousUrlState = json::parse(stateFile, nullptr, false);
+    if (!previousUrlState.is_object())
+        previousUrlState = json::object();
+    urlState = json::object();
 
-    vector<future<void>> futures;
-    //A new thread is created for each URL in this vector
+    //Seed URLs; each one adds MAX_SITES pages to the crawl budget
     vector<const char*> urls = {"http://localhost:8080", "http://example.com"};
-    for (const auto &url : urls) {
-        futures.push_back(async(launch::async, crawlWeb, url));
+
+    if (offline) {
+        // nothing is queued; every page comes from the archives
+    } else if (resume) {
+        if (!resumeCrawl()) {
+            cerr << "No usable checkpoint at " << CHECKPOINT_PATH << endl;
+            return EXIT_FAILURE;
+        }
+    } else if (recrawlPages > 0) {
+        if (!journal.open(JOURNAL_PATH))
+            cerr << "Failed to open crawl journal" << endl;
+        if (!planRecrawl(recrawlPages)) {
+            cerr << "No previous crawl to refresh in ../jsonFiles/url_state.json" << endl;
+            return EXIT_FAILURE;
+        }
+    } else {
+        if (!journal.open(JOURNAL_PATH))
+            cerr << "Failed to open crawl journal" << endl;
+
+        // Every seed starts with the same cash and is marked as visited
+        for (const auto& url : urls) {
+            string seedURL, fetchURL;
+            if (!UrlCanonicalizer().canonicalize(url, url, seedURL, &fetchURL))
+                seedURL = fetchURL = url;
+            if (!visitedURLs.insert(seedURL).second)
+                continue;
+            if (fetchURL != seedURL)
+                fetchURLs.emplace(seedURL, fetchURL);
+            journal.append(journalRecord(RECORD_VISITED).str(seedURL).data());
+            scheduler.push(seedURL, 0, 1.0);
+        }
+        scheduler.setBudget((uint64_t) MAX_SITES * urls.size());
     }
 
-    for (auto &f : futures) f.get();
+    if (!offline) {
+        if (warcOutput != nullptr && !warc.open(warcOutput, secondsSinceEpoch()))
+            cerr << "Failed to open WARC archive " << warcOutput << endl;
+
+        checkpointer.start(journal, CHECKPOINT_PATH, [](CrawlCheckpoint& checkpoint) {
+            scheduler.snapshot(checkpoint.frontier, checkpoint.sitesRemaining);
+        });
+    }
+
+    py::gil_scoped_release release;
+
+    auto crawlStart = chrono::steady_clock::now();
+    if (offline) {
+        for (const char* path : warcInputs)
+            if (!replayWarc(path, workers))
+                cerr << "Failed to read WARC archive " << path << endl;
+    } else {
+        vector<future<void>> futures;
+        for (size_t i = 0; i < workers; i++) {
+            futures.push_back(async(launch::async, crawlWeb, i));
+        }
+
+        for (auto &f : futures) f.get();
+    }
+    double crawlSeconds = chrono::duration<double>(chrono::steady_clock::now() - crawlStart).count();
+
+    checkpointer.stop();
+    journal.close();
+    warc.close();
 
     py::gil_scoped_acquire acquire;
 
@@ -145,6 +428,53 @@ int main()
     }
     outFile2 << url_to_outgoingLinks_hashmap.dump(4);
     outFile2.close();
+
+    ofstream outFile3("../jsonFiles/url_state.json");
+    if (!outFile3) {
+        cerr << "Failed to open url state file" << endl;
+        return EXIT_FAILURE;
+    }
+    outFile3 << urlState.dump();
+    outFile3.close();
+
+    ofstream outFile4("../jsonFiles/duplicates.json");
+    if (!outFile4) {
+        cerr << "Failed to open duplicates file" << endl;
+        return EXIT_FAILURE;
+    }
+    outFile4 << duplicate_to_canonical.dump(4);
+    outFile4.close();
+
+    cout << "not modified: " << pagesNotModified << " pages skipped, " << bytesNotRefetched << " bytes not refetched" << endl;
+    cout << "compression: " << wireBytes << " bytes on the wire for " << decodedBytes << " bytes of pages" << endl;
+    cout << "near-duplicates: " << nearDuplicates.duplicates << " pages dropped, " << nearDuplicates.size() << " distinct pages" << endl;
+    cout << "canonicalization: " << duplicateFetchesPrevented << " duplicate fetches prevented" << endl;
+    cout << "changes: " << pagesChanged << " refetched pages changed, " << pagesUnchanged << " unchanged" << endl;
+    if (recrawlPages > 0)
+        cout << "recrawl: " << recrawlScheduled << " pages scheduled (" << recrawlExpectedChanges << " expected to have changed), "
+             << recrawlCarriedOver << " carried over" << endl;
+    cout << "filtered: " << transfersAborted << " transfers aborted (not HTML or too large), " << binaryLinksSkipped << " binary links not queued" << endl;
+
+    if (offline) {
+        cout << "replay: " << recordsReplayed << " archived pages reprocessed in " << crawlSeconds << " s with " << workers
+             << " workers (" << recordsReplayed / max(crawlSeconds, 1e-3) << " pages/s)" << endl;
+        return EXIT_SUCCESS;
+    }
+
+    // The crawl finished and its output is written; nothing is left to resume
+    remove(JOURNAL_PATH);
+    remove(CHECKPOINT_PATH);
+    if (checkpointer.written > 0)
+        cout << "checkpoints: " << checkpointer.written << " written" << endl;
+    if (warc.records > 0)
+        cout << "warc: " << warc.records << " records archived, " << warc.compressedBytes << " bytes compressed from "
+             << warc.rawBytes << endl;
+
+    cout << "politeness: " << transferStats.transfers / max(crawlSeconds, 1e-3) << " requests/s over " << scheduler.hostCount()
+         << " hosts with " << workers << " workers, " << scheduler.idleMicros / 1e6 << " worker-seconds spent waiting for a host" << endl;
+    cout << "sitemaps: " << sitemapsFetched << " fetched, " << sitemapURLsQueued << " URLs queued" << endl;
+    cout << "robots.txt: " << robotsCache.fetches << " fetched, " << robotsCache.hits << " served from cache" << endl;
+    transferStats.report(cout);
   
     return EXIT_SUCCESS;
 }
@@ -153,10 +483,9 @@ int main()
 
 // FUNCTIONS TO CRAWL WEBPAGES AND PARSE HTML 
 
-void crawlWeb(const char* baseURL)
+void crawlWeb(size_t worker)
 {
-    Queue<string> urlQueue;
-    unsigned int sites = MAX_SITES;
+    currentWorker = worker;
 
     CURL* curl;
     curl = curl_easy_init();
@@ -165,267 +494,530 @@ void crawlWeb(const char* baseURL)
         //cout << "Failed to initialize curl" << endl;
         return;
     }
+    curlShare.attach(curl);
 
-    // keep current domain
-    string currentDomain = extractDomain(baseURL);
+    // One download buffer per worker, reused for every page
+    Buffer* buffer = bufferPool.acquire();
 
-    // Handling robots.txt for base domain
-    unordered_set<string> disallowedPaths;
-    Node robotTxtNode = fetchRobotsTxt( curl , baseURL );
-    if ( robotTxtNode.packetSize != -1 )
+    // Making request: the scheduler hands out the most important URL whose host may be
+    // fetched from now, and no other worker gets that host until this one is done with it
+    FrontierItem item;
+    while (scheduler.next(item))
     {
-        disallowedPaths = parseRobotsTxt( robotTxtNode.packetHTML );
-        free ( robotTxtNode.packetHTML) ;
-    }
+        const string& currentURL = item.url;
+        string fetchURL = fetchURLOf(currentURL);
+        cout << "crawling " << fetchURL << endl;
 
-    // Enqueue the base URL and mark it as visited
-    urlQueue.push(baseURL);
+        string origin = extractOrigin(currentURL);
 
-    visitedMutex.lock();
-    visitedURLs.insert(baseURL); 
-    visitedMutex.unlock();
+        // robots.txt is fetched once per host per TTL, whichever worker gets there first
+        shared_ptr<const RobotsRules> rules = robotsCache.get(origin, [&](const string& host) {
+            return fetchRobotsRules(curl, host, *buffer);
+        });
+        scheduler.setCrawlDelay(currentURL, rules->crawlDelay);
 
-    // Making request
-    while (sites > 0 && !urlQueue.empty())
-    {
-        cout << sites << '\n';
-        sites--;
-        cout << "sites remaining :" << sites << endl ; 
-        const string currentURL = urlQueue.front();
-        urlQueue.pop();
-
-        string newDomain  = extractDomain( currentURL ) ; 
-        if ( newDomain != currentDomain) // getting robots.txt of new domain
-        {
-            //cout << "Switching to new domain: " << newDomain << endl;
-            currentDomain = newDomain;
+        // The sitemaps it lists are read once per crawl, after the rules are cached, so no
+        // other worker waits on them
+        if (!rules->sitemaps.empty() && claimSitemaps(origin))
+            loadSitemaps(curl, origin, *rules);
 
-            // Fetch and check the robots.txt for the new domain
-            Node newRobotTxtNode = fetchRobotsTxt(curl, currentDomain.c_str());
-            if (newRobotTxtNode.packetSize != -1)
-            {
-                disallowedPaths = parseRobotsTxt(newRobotTxtNode.packetHTML);
-                free(newRobotTxtNode.packetHTML);
-            }
-            else
-            {
-                // Clear disallowed paths if no robots.txt found
-                disallowedPaths.clear();
-            }
-        }
-
-        if (!isURLAllowed(currentURL, disallowedPaths))
+        if (!isURLAllowed(fetchURL, *rules))
         {
-            cout<< "URL dissallowed by robots.txt" << currentURL << endl;
+            cout<< "URL dissallowed by robots.txt" << fetchURL << endl;
+            scheduler.done(item);
             continue;
         }
 
-        Node node = makeHTTPRequest(curl, currentURL.c_str());
-        // Parse the HTML
-        if ( node.packetSize != -1) {
-            parseHTML(node.packetHTML, newDomain.c_str(), currentURL, urlQueue);
+        // The page is parsed while it downloads
+        if (!fetchAndParsePage(curl, item, fetchURL.c_str()))
+        {
+            keepPreviousCrawl(currentURL);
+            scheduler.done(item);
         }
-        free(node.packetHTML); // Free the memory after parsing
     }
 
+    bufferPool.release(buffer);
+
     // Perform curl cleanup
     curl_easy_cleanup(curl);
 }
 
 
 
-Node makeHTTPRequest(CURL* curl, const char* baseURL)
+void setRequestOptions(CURL* curl, const char* url, size_t (*callback)(void*, size_t, size_t, void*), void* userData)
 {
-    // Node declaration
-    Node node;
-    node.packetHTML = (char*) malloc(1);
-    node.packetSize = 0;
-
-    // Set curl options
-    curl_easy_setopt(curl, CURLOPT_URL, baseURL);
-    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, storeHTML);
-    curl_easy_setopt(curl, CURLOPT_WRITEDATA, (void*)&node);
+    curl_easy_setopt(curl, CURLOPT_URL, url);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, callback);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, userData);
     curl_easy_setopt(curl, CURLOPT_USERAGENT, "Mozilla/5.0 (Windows NT 10.0; Win64; x64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/91.0.4472.124 Safari/537.36");
     curl_easy_setopt(curl, CURLOPT_TCP_KEEPALIVE, 1L);
     curl_easy_setopt(curl, CURLOPT_TIMEOUT_MS, 5000);
+    // "" asks for every encoding this libcurl can decode (gzip, brotli, zstd)
+    curl_easy_setopt(curl, CURLOPT_ACCEPT_ENCODING, "");
+    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, NULL);
+    curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, NULL);
+    curl_easy_setopt(curl, CURLOPT_HEADERDATA, NULL);
+}
 
+// Downloads baseURL into buffer, replacing its previous contents
+bool makeHTTPRequest(CURL* curl, const char* baseURL, Buffer& buffer)
+{
+    buffer.clear();
 
+    // Set curl options
+    setRequestOptions(curl, baseURL, storeHTML, (void*)&buffer);
 
     // Perform curl action
     CURLcode result = curl_easy_perform(curl);
+    transferStats.record(curl);
     if (result != CURLE_OK) 
     {
         cout << "ERROR: " << curl_easy_strerror(result) << endl;
-        node.packetSize = -1;
-        return node;
+        return false;
+    }
+
+    return true;
+}
+
+
+// Downloads a page from baseURL and feeds it to the parser chunk by chunk as it arrives, so
+// parsing overlaps the network transfer and the page is never held in memory as a whole.
+// Once it is in, the page's keywords, state and links are committed and its URL is done;
+// on failure nothing is committed and the caller marks the URL done.
+bool fetchAndParsePage(CURL* curl, const FrontierItem& item, const char* baseURL)
+{
+    const string& currentURL = item.url;
+    PageParser page;
+    beginPage(page, baseURL, currentURL);
+    page.curl = curl;
+    page.archived = warc.isOpen();
+
+    setRequestOptions(curl, baseURL, streamHTML, (void*)&page);
+    curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, storeHeader);
+    curl_easy_setopt(curl, CURLOPT_HEADERDATA, (void*)&page);
+
+    // Revalidate pages seen last crawl instead of downloading them again
+    auto previous = previousUrlState.find(currentURL);
+    struct curl_slist* conditions = NULL;
+    if (previous != previousUrlState.end())
+    {
+        if (previous->contains("etag"))
+            conditions = curl_slist_append(conditions, ("If-None-Match: " + (*previous)["etag"].get<string>()).c_str());
+        if (previous->contains("lastModified"))
+            conditions = curl_slist_append(conditions, ("If-Modified-Since: " + (*previous)["lastModified"].get<string>()).c_str());
+        curl_easy_setopt(curl, CURLOPT_HTTPHEADER, conditions);
+    }
+
+    CURLcode result = curl_easy_perform(curl);
+    transferStats.record(curl);
+    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, NULL);
+    curl_slist_free_all(conditions);
+
+    if (result != CURLE_OK) 
+    {
+        if (page.rejected != nullptr)
+        {
+            transfersAborted++;
+            cout << "Skipped " << currentURL << ": " << page.rejected << endl;
+        }
+        else
+            cout << "ERROR: " << curl_easy_strerror(result) << endl;
+        if (page.context != NULL)
+            htmlFreeParserCtxt(page.context);
+        return false;
+    }
+
+    // A checkpoint sees either none of what the page produced and its URL still queued, or
+    // all of it and the URL done
+    shared_lock<shared_mutex> commit(checkpointer.commits());
+
+    long status = 0;
+    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &status);
+    if (status == 304 && previous != previousUrlState.end())
+    {
+        // Unchanged since last crawl: nothing to parse or reindex
+        if (page.context != NULL)
+            htmlFreeParserCtxt(page.context);
+        vector<string> links;
+        reusePreviousCrawl(*previous, currentURL, baseURL, links);
+        commitLinks(item, links);
+    }
+    else
+    {
+        finishPage(page);
+        double fetchedAt = secondsSinceEpoch();
+        if (page.archived && status == 200)
+            warc.writeResponse(baseURL, fetchedAt, page.responseHeaders, page.responseBody);
+
+        curl_off_t downloaded = 0;
+        curl_easy_getinfo(curl, CURLINFO_SIZE_DOWNLOAD_T, &downloaded);
+        rememberPage(page, downloaded, previous != previousUrlState.end() ? &*previous : nullptr, fetchedAt);
+        commitLinks(item, page.links);
+    }
+
+    scheduler.done(item);
+    return true;
+}
+
+// Queues the links that are new one level deeper than their page, records them as its
+// outgoing links, and gives the page's cash to all of them
+void commitLinks(const FrontierItem& item, const vector<string>& links)
+{
+    for (const auto& link : links)
+    {
+        visitedMutex.lock();
+        bool added = visitedURLs.insert(link).second;
+        visitedMutex.unlock();
+        if (!added)
+            continue;
+
+        if (!offline)
+            scheduler.push(link, item.depth + 1);
+
+        outgoingLinksMutex.lock();
+        url_to_outgoingLinks_hashmap[item.url].push_back(link);
+        outgoingLinksMutex.unlock();
+
+        journal.append(journalRecord(RECORD_VISITED).str(link).data());
+        journal.append(journalRecord(RECORD_LINK).str(item.url).str(link).data());
     }
 
-    // converting node HTML to lowercase before returning
-    string content(node.packetHTML);
-    transform(content.begin(), content.end(), content.begin(), ::tolower);
-    strcpy(node.packetHTML, content.c_str());
+    if (!offline)
+        scheduler.distribute(item.cash, links);
+}
+
+// Records the validators, content hash, change history, keywords and links of a page
+// fetched (or archived) at fetchedAt for the next crawl
+void rememberPage(PageParser& page, curl_off_t downloaded, const json* previous, double fetchedAt)
+{
+    wireBytes += downloaded;
+    decodedBytes += page.bodyBytes;
 
-    return node;
+    // A page counts as changed when its bytes did; last crawl's hash is the only witness.
+    // An archived response no newer than last crawl's fetch adds nothing to the history.
+    ChangeHistory history;
+    if (previous != nullptr && previous->contains("hash"))
+    {
+        history = readChangeHistory(*previous);
+        if (fetchedAt > history.lastFetched)
+        {
+            bool changed = (*previous)["hash"].get<uint64_t>() != page.contentHash;
+            history.observe(fetchedAt, changed);
+            (changed ? pagesChanged : pagesUnchanged)++;
+        }
+    }
+    else
+        history.observe(fetchedAt, true);
+
+    json state = {{"bytes", downloaded}, {"keywords", move(page.keywords)}, {"links", page.links}, {"hash", page.contentHash}};
+    writeChangeHistory(state, history);
+    if (page.fingerprint != 0)
+        state["simhash"] = page.fingerprint;
+    if (!page.etag.empty())
+        state["etag"] = page.etag;
+    if (!page.lastModified.empty())
+        state["lastModified"] = page.lastModified;
+    if (page.fetchURL != *page.currentURL)
+        state["fetchURL"] = page.fetchURL;
+
+    journal.append(journalRecord(RECORD_URL_STATE).str(*page.currentURL).str(state.dump()).data());
+
+    lock_guard<mutex> guard(urlStateMutex);
+    urlState[*page.currentURL] = move(state);
 }
 
+// Emits what a 304 page produced last crawl and follows its links as if it had been parsed
+void reusePreviousCrawl(const json& previous, const string& currentURL, const char* baseURL, vector<string>& links)
+{
+    pagesNotModified++;
+    pagesUnchanged++;
+    bytesNotRefetched += previous.value("bytes", (uint64_t)0);
+
+    emitPreviousPage(previous, currentURL);
 
-void parseHTML(char* HTML, const char* baseURL, const string& currentURL, Queue<string>& urlQueue) {
-    htmlDocPtr doc = htmlReadMemory(HTML, strlen(HTML), baseURL, NULL, HTML_PARSE_NOERROR | HTML_PARSE_NOWARNING);
-    if (doc == NULL) {
+    if (previous.contains("links"))
+    {
+        for (const auto& link : previous["links"])
+            handleURLDetection(link.get<string>().c_str(), baseURL, links);
+    }
+
+    // Still the same page, one more fetch that found it unchanged
+    json state = previous;
+    ChangeHistory history = readChangeHistory(state);
+    history.observe(secondsSinceEpoch(), false);
+    writeChangeHistory(state, history);
+
+    journal.append(journalRecord(RECORD_URL_STATE).str(currentURL).str(state.dump()).data());
+
+    lock_guard<mutex> guard(urlStateMutex);
+    urlState[currentURL] = move(state);
+}
+
+// Puts a page from last crawl back into the index: its fingerprint, so this crawl's
+// duplicates of it are caught, and its keywords unless it is a duplicate itself
+void emitPreviousPage(const json& previous, const string& currentURL)
+{
+    string canonical;
+    bool duplicate = previous.contains("simhash") &&
+                     recordNearDuplicate(previous["simhash"].get<uint64_t>(), currentURL, canonical);
+
+    if (!duplicate && previous.contains("keywords"))
+    {
+        lock_guard<mutex> guard(hashmapMutex);
+        for (const auto& [keyword, frequency] : previous["keywords"].items())
+        {
+            keyword_to_url_hashmap[keyword].push_back({{currentURL, frequency}});
+            journal.append(journalRecord(RECORD_KEYWORD).str(keyword).str(currentURL).f32(frequency.get<float>()).data());
+        }
+    }
+}
+
+// A page that could not be fetched this time keeps what last crawl recorded for it, so a
+// timeout doesn't drop it from the index
+void keepPreviousCrawl(const string& currentURL)
+{
+    auto previous = previousUrlState.find(currentURL);
+    if (previous == previousUrlState.end())
+        return;
+
+    shared_lock<shared_mutex> commit(checkpointer.commits());
+    emitPreviousPage(*previous, currentURL);
+    journal.append(journalRecord(RECORD_URL_STATE).str(currentURL).str(previous->dump()).data());
+
+    lock_guard<mutex> guard(urlStateMutex);
+    urlState[currentURL] = *previous;
+}
+
+void beginPage(PageParser& page, const char* baseURL, const string& currentURL) {
+    // Only the events we use; with no tree-building callbacks libxml2 never builds a DOM
+    static htmlSAXHandler saxHandler = [] {
+        htmlSAXHandler handler;
+        memset(&handler, 0, sizeof(handler));
+        handler.startElement = onStartElement;
+        handler.endElement = onEndElement;
+        handler.characters = onCharacters;
+        handler.ignorableWhitespace = onCharacters;
+        handler.cdataBlock = onIgnoredText; // <script> and <style> bodies
+        return handler;
+    }();
+
+    page.fetchURL = baseURL;
+    page.baseURL = baseURL;
+    page.currentURL = &currentURL;
+    page.context = htmlCreatePushParserCtxt(&saxHandler, &page, NULL, 0, currentURL.c_str(), XML_CHAR_ENCODING_NONE);
+    if (page.context != NULL)
+        htmlCtxtUseOptions(page.context, HTML_PARSE_NOERROR | HTML_PARSE_NOWARNING | HTML_PARSE_NONET);
+}
+
+void feedPage(PageParser& page, const char* chunk, size_t length) {
+    if (page.context != NULL)
+        htmlParseChunk(page.context, chunk, (int)length, 0);
+}
+
+void finishPage(PageParser& page) {
+    if (page.context == NULL) {
         cout << "Parsing failed. Exiting function" << endl;
         return;
     }
 
-    xmlNode* rootNode = xmlDocGetRootElement(doc);
-    unsigned int totalWords = 0;
-    keywordCountDOMTraversal(rootNode, baseURL, currentURL, HTML, &totalWords);
-    dom_traversal_and_processing(rootNode, baseURL, currentURL, HTML, &totalWords, urlQueue);
+    htmlParseChunk(page.context, NULL, 0, 1);
+    addPageWord(page);
+    // A near-duplicate keeps its links but adds nothing to the index
+    if (!isNearDuplicate(page))
+        handleKeyWordsDetection(page);
 
-    xmlFreeDoc(doc);
+    htmlFreeParserCtxt(page.context);
+    page.context = NULL;
 }
 
-void dom_traversal_and_processing(xmlNode* node, const char* baseURL, const string& currentURL, char* HTML_CONTENT, unsigned int *totalWords, Queue<string>& urlQueue) {
-    for (; node; node = node->next) {
-        if (xmlStrcasecmp(node->name, BAD_CAST "a") == 0)
-            handleURLDetection(node, baseURL, currentURL, urlQueue);
+bool isHeadingTag(const xmlChar* name) {
+    return xmlStrcasecmp(name, BAD_CAST "title") == 0 ||
+           ((name[0] == 'h' || name[0] == 'H') && name[1] >= '1' && name[1] <= '6' && name[2] == 0);
+}
 
-        if (xmlStrcasecmp(node->name, BAD_CAST "title") == 0 || 
-            xmlStrcasecmp(node->name, BAD_CAST "h1") == 0 ||
-            xmlStrcasecmp(node->name, BAD_CAST "h2") == 0 || 
-            xmlStrcasecmp(node->name, BAD_CAST "h3") == 0 ||
-            xmlStrcasecmp(node->name, BAD_CAST "h4") == 0 ||
-            xmlStrcasecmp(node->name, BAD_CAST "h5") == 0 ||
-            xmlStrcasecmp(node->name, BAD_CAST "h6") == 0) {
-            handleKeyWordsDetection(node, currentURL, HTML_CONTENT, totalWords);
+void onStartElement(void* ctx, const xmlChar* name, const xmlChar** attributes) {
+    PageParser* page = (PageParser*) ctx;
+    addPageWord(*page); // tags end words
+
+    // The first <base href> replaces the page's URL for resolving the links after it
+    if (xmlStrcasecmp(name, BAD_CAST "base") == 0 && attributes != NULL && !page->baseElementSeen) {
+        for (size_t i = 0; attributes[i] != NULL; i += 2) {
+            if (xmlStrcasecmp(attributes[i], BAD_CAST "href") != 0 || attributes[i + 1] == NULL)
+                continue;
+            static thread_local UrlCanonicalizer canonicalizer;
+            string key, resolved;
+            if (canonicalizer.canonicalize(page->baseURL, (const char*) attributes[i + 1], key, &resolved))
+                page->baseURL = move(resolved);
+            page->baseElementSeen = true;
+            break;
         }
+    }
 
-        dom_traversal_and_processing(node->children, baseURL, currentURL, HTML_CONTENT, totalWords, urlQueue);
+    if (xmlStrcasecmp(name, BAD_CAST "a") == 0 && attributes != NULL) {
+        for (size_t i = 0; attributes[i] != NULL; i += 2) {
+            if (xmlStrcasecmp(attributes[i], BAD_CAST "href") == 0 && attributes[i + 1] != NULL)
+                handleURLDetection((const char*) attributes[i + 1], page->baseURL.c_str(), page->links);
+        }
     }
+
+    if (isHeadingTag(name))
+        page->headingDepth++;
 }
 
-void keywordCountDOMTraversal(xmlNode *node, const char *baseURL, const string& currentURL, char* HTML_CONTENT, unsigned int *totalWords) {
-    for (; node; node = node->next) {
-        if (xmlStrcasecmp(node->name, BAD_CAST "title") == 0 || 
-            xmlStrcasecmp(node->name, BAD_CAST "h1") == 0 ||
-            xmlStrcasecmp(node->name, BAD_CAST "h2") == 0 || 
-            xmlStrcasecmp(node->name, BAD_CAST "h3") == 0 ||
-            xmlStrcasecmp(node->name, BAD_CAST "h4") == 0 ||
-            xmlStrcasecmp(node->name, BAD_CAST "h5") == 0 ||
-            xmlStrcasecmp(node->name, BAD_CAST "h6") == 0 ||
-            xmlStrcasecmp(node->name, BAD_CAST "p")) {
-            getTotalWordCount(node, totalWords);
-        }
+void onEndElement(void* ctx, const xmlChar* name) {
+    PageParser* page = (PageParser*) ctx;
+    addPageWord(*page);
 
-        keywordCountDOMTraversal(node->children, baseURL, currentURL, HTML_CONTENT, totalWords);
+    if (isHeadingTag(name) && page->headingDepth > 0 && --page->headingDepth == 0) {
+        page->headings += page->headingText;
+        page->headings += ' ';
+        page->headingText.clear();
     }
 }
 
+void onCharacters(void* ctx, const xmlChar* text, int length) {
+    PageParser* page = (PageParser*) ctx;
+
+    if (page->headingDepth > 0 && page->headingText.length() < MAX_HEADING_TEXT)
+        page->headingText.append((const char*) text, length);
+
+    // A token at offset 0 continues the word left over from the previous callback,
+    // anything else was separated from it by a non-letter
+    AsciiTokenizer::local().forEachToken(string_view((const char*) text, length), [&](string_view token, size_t offset) {
+        if (offset != 0)
+            addPageWord(*page);
+        size_t room = MAX_WORD_LENGTH - min<size_t>(page->pendingWord.length(), MAX_WORD_LENGTH);
+        page->pendingWord.append(token.data(), min(token.length(), room));
+    });
+
+    unsigned char last = length > 0 ? text[length - 1] : ' ';
+    if (!isalpha(last))
+        addPageWord(*page);
+}
+
+void onIgnoredText(void*, const xmlChar*, int) {
+}
 
 
 
 //FUNCTIONS TO PROCESS HTML CONTENT
 
-void handleURLDetection(xmlNode* node , const char* baseURL , const string& currentURL, Queue<string>& urlQueue)
+// Adds the canonical form of the link to the page's links; they are queued once the page
+// has been fetched completely (see commitLinks)
+void handleURLDetection(const char* href , const char* baseURL , vector<string>& links)
 {
-    xmlChar* href = xmlGetProp(node, BAD_CAST "href");
+    // Resolved and normalized into a per-thread buffer
+    static thread_local UrlCanonicalizer canonicalizer;
+    static thread_local string canonicalURL;
+    static thread_local string resolvedURL;
 
-    if (href == nullptr) 
-        return;
-    
-    // Check if the href starts with '#' (fragment link)
-    if (strncmp((const char*)href, "#", 1) == 0) 
+    if (!canonicalizer.canonicalize(baseURL, href, canonicalURL, &resolvedURL))
+        return; // not http(s), or a link within the same page
+
+    // Images, archives and documents are kept out of the frontier altogether
+    if (hasBinaryExtension(canonicalURL))
     {
-        xmlFree(href);
+        binaryLinksSkipped++;
         return;
     }
 
-    char* resolvedURL = resolveURL(baseURL, (const char*)href);
-    if (resolvedURL != nullptr)
+    // only canonicalization made this link match a URL we already have
+    if (canonicalizer.lastChanged())
     {
-        // CONVERT INTO SEPERATE FUNCTION 
+        lock_guard<mutex> guard(visitedMutex);
+        if (visitedURLs.count(canonicalURL) > 0)
+            duplicateFetchesPrevented++;
+    }
 
-            // checking if url has valid scheme
-        if (strncmp(resolvedURL, "http://", 7) != 0 && strncmp(resolvedURL, "https://", 8) != 0) 
-        {
-            free(resolvedURL);
-            xmlFree(href);
-            return;
-        }
+    // The key loses a directory's trailing slash or its default document; the page is
+    // fetched, and its own links resolved, under the URL it was linked as
+    if (resolvedURL != canonicalURL)
+    {
+        lock_guard<mutex> guard(fetchURLsMutex);
+        fetchURLs.emplace(canonicalURL, resolvedURL);
+    }
 
-        // Ensuring domain consist
-        string tempUrlString(resolvedURL);  // THESE THREE ATTRIBUTES ARE USED LATER
-        size_t posDot1 = tempUrlString.find("//") + 2; // Find the start of the domain
-        size_t posDot2 = tempUrlString.find("/", posDot1); // Find the end of the domain part
+    // Every link counts towards the importance of its target, visited or not
+    links.push_back(canonicalURL);
+}
 
-        if (posDot2 == string::npos) 
-            posDot2 = tempUrlString.length(); 
-        
+// The URL a queued URL is fetched from
+string fetchURLOf(const string& url)
+{
+    lock_guard<mutex> guard(fetchURLsMutex);
+    auto it = fetchURLs.find(url);
+    return it != fetchURLs.end() ? it->second : url;
+}
 
-        // Convert the domain part to lowercase
-        for (int i = posDot1; i < posDot2; i++) {
-            tempUrlString[i] = tolower(tempUrlString[i]);
-        }
+// True when the last path segment ends in an extension that is never an HTML page
+bool hasBinaryExtension(const string& url)
+{
+    size_t hostStart = url.find("://");
+    hostStart = hostStart == string::npos ? 0 : hostStart + 3;
+    size_t pathEnd = url.find_first_of("?#", hostStart);
+    if (pathEnd == string::npos)
+        pathEnd = url.length();
+
+    size_t slash = url.rfind('/', pathEnd - 1);
+    size_t dot = url.rfind('.', pathEnd - 1);
+    if (slash == string::npos || slash < hostStart || dot == string::npos || dot < slash)
+        return false;
+
+    string extension = url.substr(dot + 1, pathEnd - dot - 1);
+    if (extension.empty() || extension.length() > 5)
+        return false;
+    for (auto& c : extension)
+        c = tolower(c);
+
+    return binaryExtensions.count(extension) > 0;
+}
 
-        // Standardizing all URLs to "www" prefix
-        // if (strncmp(tempUrlString.c_str(), "http://www.", 11) != 0 && strncmp(tempUrlString.c_str(), "https://www.", 12) != 0) 
-        // {
-        //     tempUrlString = tempUrlString.substr(0, posDot1) + "www." + tempUrlString.substr(posDot1);
-        // }
+// Fingerprints the page's words and checks them against every page seen so far
+bool isNearDuplicate(PageParser& page) {
+    if (page.pageWords.getSize() < SIMHASH_MIN_WORDS)
+        return false;
 
-        // removing traling slashes
-        if (tempUrlString[tempUrlString.length() - 1] == '/') 
-            tempUrlString = tempUrlString.substr(0, tempUrlString.length() - 1);  // Remove the last character
+    SimHash simhash;
+    for (const auto& [word, occurrences] : page.pageWords)
+        simhash.add(word, occurrences);
+    page.fingerprint = simhash.fingerprint();
 
+    return recordNearDuplicate(page.fingerprint, *page.currentURL, page.duplicateOf);
+}
 
-        // If you need to convert back to char* (if other parts of your code require it):
-        free(resolvedURL);  // Free the old resolvedURL memory if it was previously allocated
-        resolvedURL = strdup(tempUrlString.c_str());  // Allocate new memory for char* with the updated URL
+// Either makes the page canonical for its fingerprint or maps it to the page that is
+bool recordNearDuplicate(uint64_t fingerprint, const string& currentURL, string& canonical) {
+    if (!nearDuplicates.findOrInsert(fingerprint, currentURL, canonical)) {
+        journal.append(journalRecord(RECORD_FINGERPRINT).str(currentURL).u64(fingerprint).data());
+        return false;
+    }
 
+    journal.append(journalRecord(RECORD_DUPLICATE).str(currentURL).str(canonical).data());
+    lock_guard<mutex> guard(duplicatesMutex);
+    duplicate_to_canonical[currentURL] = canonical;
+    return true;
+}
 
+// Emits the page's heading keywords with their relative frequency in the page text
+void handleKeyWordsDetection(PageParser& page) {
+    HashMap<string, unsigned int> keywordsCount;
 
-        // Check if this URL has already been visited
-        string urlString(resolvedURL);
-        visitedMutex.lock();
-        if (visitedURLs.find(urlString) == visitedURLs.end()) 
-        {
-            // cout << "Found URL: " << urlString << endl;
-            visitedURLs.insert(urlString);  // Add to visited set
-            visitedMutex.unlock();
-
-            urlQueue.push(urlString);
-            
-            outgoingLinksMutex.lock();
-            url_to_outgoingLinks_hashmap[currentURL].push_back(resolvedURL);
-            outgoingLinksMutex.unlock();
-        }
-        else visitedMutex.unlock();
+    if (page.headings.empty() || page.totalWords == 0)
+        return;
 
-        free(resolvedURL);
+    for (const auto& keyword : processKeyWords(page.headings)) {
+        if (keywordsCount.find(keyword) == nullptr)
+            keywordsCount.insert({keyword, getKeywordCount(keyword, page)});
     }
-    xmlFree(href);
-}
 
-void handleKeyWordsDetection(xmlNode* node, const string& currentURL , char* HTML_CONTENT, unsigned int *totalWords) {
-    HashMap<string, int> keywordsCount;
-    vector<string> keyWordsList;
-
-    xmlChar* rawText = xmlNodeGetContent(node);
-    if (rawText) {
-        string rawTextString((char*)rawText);
-        keyWordsList = processKeyWords(rawTextString);
-        for (const auto& keyword : keyWordsList) {
-            keywordsCount.insert({keyword, getKeywordCount(keyword , HTML_CONTENT)});
+    for (const auto& [keyword, count] : keywordsCount) {
+        if (count > 0) {
+            hashmapMutex.lock();
+            keyword_to_url_hashmap[keyword].push_back({{*page.currentURL, ((float)count / page.totalWords)}});
+            hashmapMutex.unlock();
+            journal.append(journalRecord(RECORD_KEYWORD).str(keyword).str(*page.currentURL).f32((float)count / page.totalWords).data());
+            page.keywords[keyword] = (float)count / page.totalWords;
         }
-
-        for (const auto& [keyword, count] : keywordsCount) {
-            if (count > 0) {
-                hashmapMutex.lock();
-                keyword_to_url_hashmap[keyword].push_back({{currentURL, ((float)count / *totalWords)}});
-                hashmapMutex.unlock();
-            }
-        }
-
-        xmlFree(rawText);
     }
 }
 
@@ -441,101 +1033,166 @@ void removeDuplicates(json& j) {
     }
 }
 
-int getKeywordCount(string keyword , char* HTML_Content) {
-    int count = 0;
-    const string content(HTML_Content);
-    size_t pos = content.find(keyword);
+// Counts occurrences of a keyword inside the page's words (a keyword also matches
+// inside longer words, e.g. "run" in "running")
+unsigned int getKeywordCount(const string& keyword, PageParser& page) {
+    unsigned int count = 0;
 
-    while (pos != string::npos) {
-        ++count;
-        pos = content.find(keyword, pos + 1); // Move to the next occurrence
+    for (const auto& [word, occurrences] : page.pageWords) {
+        size_t pos = word.find(keyword);
+        while (pos != string::npos) {
+            count += occurrences;
+            pos = word.find(keyword, pos + 1); // Move to the next occurrence
+        }
     }
 
     return count;
 }
 
-unsigned int countWords(const string &text) {
-    istringstream stream(text);
-    return distance(istream_iterator<string>(stream), istream_iterator<string>());
-}
-
-void getTotalWordCount(xmlNode *node, unsigned int *totalWords) {
-    if (!node || !totalWords) {
+// Records the word collected so far. Past MAX_PAGE_WORDS distinct words only
+// known words are counted, which keeps memory bounded on huge pages.
+void addPageWord(PageParser& page) {
+    if (page.pendingWord.empty())
         return;
-    }
 
-    for (xmlNode *current = node; current; current = current->next) {
-        if (current->type == XML_TEXT_NODE) {
-            string text(reinterpret_cast<const char *>(current->content));
-            *totalWords += countWords(text);
-        }
-    }
+    page.totalWords++;
+    unsigned int* occurrences = page.pageWords.find(page.pendingWord);
+    if (occurrences != nullptr)
+        (*occurrences)++;
+    else if (page.pageWords.getSize() < MAX_PAGE_WORDS)
+        page.pageWords.insert({page.pendingWord, 1});
+
+    page.pendingWord.clear();
 }
 
 // UTILITY FUNCTIONS 
 
-// funtion to get absoloute URL
-char* resolveURL(const char* baseURL, const char* relativeURL) 
+// scheme://host[:port] of a URL, with the scheme and host lowercased
+string extractOrigin(const string& url)
 {
-    // If the relative URL is actually an absolute URL, return it directly
-    if (strncmp(relativeURL, "http://", 7) == 0 || strncmp(relativeURL, "https://", 8) == 0) {
-        return strdup(relativeURL);  // Return the absolute URL directly
-    }
+    size_t protocolPos = url.find("://");
+    size_t hostStart = (protocolPos == string::npos) ? 0 : protocolPos + 3;
+    size_t hostEnd = url.find_first_of("/?#", hostStart);
+    if (hostEnd == string::npos)
+        hostEnd = url.length();
+
+    string origin = (protocolPos == string::npos ? string("http://") : "") + url.substr(0, hostEnd);
+    for (auto& c : origin)
+        c = tolower(c);
+    return origin;
+}
 
-    //In case or relative url
-    xmlChar* fullURL = xmlBuildURI(BAD_CAST relativeURL, BAD_CAST baseURL);
-    if (fullURL == NULL)
-        return NULL;
 
-    char* result = strdup((const char*) fullURL);
-    xmlFree(fullURL);
 
-    return result;
-}
 
-string extractDomain(const string& url)
-{
-    size_t protocolPos = url.find("://");
-    size_t domainStart = (protocolPos == string::npos) ? 0 : protocolPos + 3;
 
-    // Find the position of the first '/' after the domain
-    size_t domainEnd = url.find("/", domainStart);
-    if (domainEnd == string::npos) {
-        domainEnd = url.length();
-    }
+// CALLBACK FUNCTIONS
+size_t streamHTML(void* packetContent, size_t size, size_t nmemb, void* page) 
+{
+    PageParser* castedPage = (PageParser*) page;
 
-    // Extract the domain part
-    string domain = url.substr(domainStart, domainEnd - domainStart);
+    // Links resolve against the URL the body actually came from
+    char* effectiveURL = nullptr;
+    if (castedPage->bodyBytes == 0 && castedPage->curl != nullptr &&
+        curl_easy_getinfo(castedPage->curl, CURLINFO_EFFECTIVE_URL, &effectiveURL) == CURLE_OK && effectiveURL != nullptr)
+        castedPage->baseURL = effectiveURL;
 
-    // Split the domain by '.' to identify parts
-    size_t lastDot = domain.rfind('.');
-    size_t secondLastDot = domain.rfind('.', lastDot - 1);
+    // A missing or lying Content-Length is caught here, on the decoded bytes
+    castedPage->bodyBytes += size * nmemb;
+    if (castedPage->bodyBytes > MAX_PAGE_BYTES)
+    {
+        castedPage->rejected = "body over the size limit";
+        return 0;
+    }
 
-    // If there are two or more parts, extract SLD + TLD
-    if (secondLastDot != string::npos) {
-        return domain.substr(secondLastDot + 1);
+    const unsigned char* bytes = (const unsigned char*) packetContent;
+    for (size_t i = 0; i < size * nmemb; i++)
+    {
+        castedPage->contentHash ^= bytes[i];
+        castedPage->contentHash *= 0x100000001B3ULL;
     }
 
-    return domain;
+    if (castedPage->archived)
+        castedPage->responseBody.append((const char*) packetContent, size * nmemb);
+
+    feedPage(*castedPage, (const char*) packetContent, size * nmemb);
+    return size * nmemb;
 }
 
+// Picks the cache validators out of the response headers
+size_t storeHeader(char* header, size_t size, size_t nitems, void* page)
+{
+    PageParser* castedPage = (PageParser*) page;
+    string_view line(header, size * nitems);
+    while (!line.empty() && (line.back() == '\r' || line.back() == '\n'))
+        line.remove_suffix(1);
 
+    // a new status line means a redirect; only the final response's headers count
+    if (line.substr(0, 5) == "HTTP/")
+    {
+        castedPage->etag.clear();
+        castedPage->lastModified.clear();
+        castedPage->contentHash = 0xCBF29CE484222325ULL;
+        castedPage->rejected = nullptr;
+        castedPage->responseHeaders.clear();
+        castedPage->responseBody.clear();
+        if (castedPage->archived)
+            castedPage->responseHeaders.append(line).append("\r\n");
+        return size * nitems;
+    }
 
+    size_t colon = line.find(':');
+    if (colon == string_view::npos)
+        return size * nitems;
+
+    string_view name = line.substr(0, colon);
+    string_view value = line.substr(colon + 1);
+    while (!value.empty() && value.front() == ' ')
+        value.remove_prefix(1);
+
+    // The archive holds the decoded body, so the headers that describe the wire format go
+    if (castedPage->archived &&
+        !(name.length() == 16 && strncasecmp(name.data(), "content-encoding", 16) == 0) &&
+        !(name.length() == 17 && strncasecmp(name.data(), "transfer-encoding", 17) == 0) &&
+        !(name.length() == 14 && strncasecmp(name.data(), "content-length", 14) == 0))
+        castedPage->responseHeaders.append(line).append("\r\n");
+
+    if (name.length() == 4 && strncasecmp(name.data(), "etag", 4) == 0)
+        castedPage->etag = value;
+    else if (name.length() == 13 && strncasecmp(name.data(), "last-modified", 13) == 0)
+        castedPage->lastModified = value;
+    else if (name.length() == 12 && strncasecmp(name.data(), "content-type", 12) == 0)
+    {
+        // returning less than we were given aborts the transfer before the body arrives
+        bool html = value.length() >= 9 && strncasecmp(value.data(), "text/html", 9) == 0;
+        bool xhtml = value.length() >= 21 && strncasecmp(value.data(), "application/xhtml+xml", 21) == 0;
+        if (!html && !xhtml && !value.empty())
+        {
+            castedPage->rejected = "not HTML";
+            return 0;
+        }
+    }
+    else if (name.length() == 14 && strncasecmp(name.data(), "content-length", 14) == 0)
+    {
+        if (strtoull(string(value).c_str(), nullptr, 10) > MAX_PAGE_BYTES)
+        {
+            castedPage->rejected = "Content-Length over the size limit";
+            return 0;
+        }
+    }
 
+    return size * nitems;
+}
 
-// CALLBACK FUNCTION
-size_t storeHTML(void* packetContent, size_t size, size_t nmemb, void* node) 
+size_t storeHTML(void* packetContent, size_t size, size_t nmemb, void* buffer) 
 {
-    Node* castedNode = (Node*) node;
+    Buffer* castedBuffer = (Buffer*) buffer;
 
-    char* tempPtr = (char*) realloc(castedNode->packetHTML, castedNode->packetSize + (size * nmemb) + 1);
-    if (tempPtr == NULL)
+    // returning less than we were given makes curl abort the transfer
+    if (castedBuffer->size + size * nmemb > MAX_PAGE_BYTES)
+        return 0;
+    if (!castedBuffer->append(packetContent, size * nmemb))
         return 0;
-
-    castedNode->packetHTML = tempPtr;
-    memcpy(&(castedNode->packetHTML[castedNode->packetSize]), packetContent, size * nmemb);
-    castedNode->packetSize += size * nmemb;
-    castedNode->packetHTML[castedNode->packetSize] = 0;
 
     return size * nmemb;
 }
@@ -544,110 +1201,171 @@ size_t storeHTML(void* packetContent, size_t size, size_t nmemb, void* node)
 
 // FUNTIONS TO CHECK ROBOT.TXT COMPLIANCE
 
-Node fetchRobotsTxt ( CURL* curl , const char* baseURL )
+// Returns the host's compiled rules, empty rules when it has no robots.txt, or null
+// when it could not be fetched
+shared_ptr<const RobotsRules> fetchRobotsRules(CURL* curl, const string& origin, Buffer& buffer)
 {
-    string robotTxtURL = string(baseURL) + "/robots.txt";
-    Node node = makeHTTPRequest ( curl , robotTxtURL.c_str() );
-    return node;
+    string robotTxtURL = origin + "/robots.txt";
+    if (!makeHTTPRequest(curl, robotTxtURL.c_str(), buffer))
+        return nullptr;
+
+    long status = 0;
+    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &status);
+    if (status >= 400 && status < 500) // no robots.txt, everything is allowed
+        return make_shared<RobotsRules>();
+    if (status < 200 || status >= 300)
+        return nullptr;
+
+    return parseRobotsRules(string_view(buffer.data, buffer.size));
 }
 
-unordered_set<string> parseRobotsTxt ( char* robotsTxtContent )
+bool isURLAllowed(const string& currentURL, const RobotsRules& rules)
 {
+    // Rules match the path and query that follow the host
+    size_t hostStart = currentURL.find("://");
+    hostStart = hostStart == string::npos ? 0 : hostStart + 3;
+    size_t pathStart = currentURL.find_first_of("/?#", hostStart);
 
-    // treat sting::npos like null
-    unordered_set<string> disallowedPaths;
-    string userAgent = "User-agent: *"; // Checks for global rules rather than rule for specific crawler
+    string_view path = pathStart == string::npos ? string_view("/") : string_view(currentURL).substr(pathStart);
+    size_t fragment = path.find('#');
+    if (fragment != string_view::npos) path = path.substr(0, fragment);
 
-    char* line = strtok( robotsTxtContent , "\n" );
-    bool isGlobalAgent = false;
+    return rules.allowed(path);
+}
 
-    while ( line != NULL )
-    {
-        string lineStr  = string ( line );
 
-        // checking for global agent
-        if ( lineStr.find("User-agent: *")  != string::npos) // if we encouter a global user agent
-            isGlobalAgent = true;
-       else if ( isGlobalAgent && lineStr.find("User-agent:") != string::npos) // if we encounter some other user agent
-            isGlobalAgent = false;
 
-        // extracting disallowed paths
-        if ( isGlobalAgent && ( lineStr.find("Disallow") != string::npos ) ) 
+// FUNCTIONS TO SEED THE FRONTIER FROM SITEMAPS
+
+size_t streamSitemap(void* packetContent, size_t size, size_t nmemb, void* parser)
+{
+    // returning less than we were given makes curl abort the transfer
+    if (!((SitemapParser*) parser)->feed((const char*) packetContent, size * nmemb))
+        return 0;
+    return size * nmemb;
+}
+
+// True for the first worker to ask about origin this crawl, which then reads its sitemaps
+bool claimSitemaps(const string& origin)
+{
+    static mutex claimedMutex;
+    static unordered_set<string> claimed;
+    lock_guard<mutex> guard(claimedMutex);
+    return claimed.insert(origin).second;
+}
+
+// Reads the sitemaps robots.txt lists for a host, following sitemap indexes, and queues
+// every page they name. A few requests enumerate a site that would otherwise take a fetch
+// per level of link depth to discover.
+void loadSitemaps(CURL* curl, const string& origin, const RobotsRules& rules)
+{
+    deque<string> pending(rules.sitemaps.begin(), rules.sitemaps.end());
+    unordered_set<string> seen(pending.begin(), pending.end());
+    vector<SitemapEntry> entries;
+
+    for (size_t fetched = 0; !pending.empty() && fetched < MAX_SITEMAPS_PER_HOST; fetched++)
+    {
+        string location = move(pending.front());
+        pending.pop_front();
+
+        // These requests bypass the scheduler, so they keep to the host's Crawl-delay here
+        if (fetched > 0 && rules.crawlDelay > 0)
+            this_thread::sleep_for(chrono::duration<double>(min<double>(rules.crawlDelay, MAX_CRAWL_DELAY_SECONDS)));
+
+        SitemapParser parser(location);
+        setRequestOptions(curl, location.c_str(), streamSitemap, (void*)&parser);
+        CURLcode result = curl_easy_perform(curl);
+        transferStats.record(curl);
+        sitemapsFetched++;
+
+        long status = 0;
+        curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &status);
+        if (result != CURLE_OK || status != 200)
         {
-            size_t colonPos = lineStr.find(":");
-            if ( colonPos != string::npos && ( colonPos + 1 < lineStr.size() ) )
-            {   
-                try
-                {
-                    string disallowedPath = lineStr.substr( colonPos + 1);
-                    disallowedPath.erase( remove ( disallowedPath.begin() , disallowedPath.end() , ' ') , disallowedPath.end() ) ; // removing spaces from disallowed path
-                    disallowedPaths.insert( disallowedPath );
-                }
-                catch ( exception& e)
-                {
-                    cout << "Caught exception: " << e.what() << endl;
-                }
-            }
+            cout << "Skipped sitemap " << location << ": " << (result != CURLE_OK ? curl_easy_strerror(result) : "HTTP error") << endl;
+            continue;
         }
+        parser.finish();
 
-        line = strtok( NULL , "\n" );
+        for (auto& nested : parser.sitemaps)
+            if (seen.insert(nested).second)
+                pending.push_back(move(nested));
+        move(parser.urls.begin(), parser.urls.end(), back_inserter(entries));
     }
 
-    return disallowedPaths;
+    queueSitemapURLs(origin, rules, entries);
 }
 
-bool isURLAllowed(const string currentURL , const unordered_set<string>& disallowedPaths)
+// Bulk-loads sitemap URLs of the host into the visited set and the frontier, one level below
+// the seeds. The host's SITEMAP_CASH is split among them, and a page whose <lastmod> is
+// older than last crawl's fetch of it gets a smaller share: it will most likely come back
+// as a 304, so pages that did change go first.
+void queueSitemapURLs(const string& origin, const RobotsRules& rules, const vector<SitemapEntry>& entries)
 {
-    // Extract path starting after "https://"
-    string urlPath;
-    size_t pos = currentURL.find("/", 8);  // Find position of "/" after "https://"
+    UrlCanonicalizer canonicalizer;
+    string canonicalURL;
+    vector<FrontierItem> items;
+    vector<double> weights;
+    double totalWeight = 0;
+    for (const auto& entry : entries)
+    {
+        // Only the host's own pages; robots.txt vouches for no other host
+        if (!canonicalizer.canonicalize(origin, entry.url, canonicalURL) || extractOrigin(canonicalURL) != origin)
+            continue;
+        if (hasBinaryExtension(canonicalURL) || !isURLAllowed(canonicalURL, rules))
+            continue;
 
-    // Check if the position is valid
-    if (pos != string::npos) 
-        urlPath = currentURL.substr(pos);
-    else 
-        urlPath = "/";  // Handle the case where no "/" is found after the domain
+        double weight = 1;
+        auto previous = previousUrlState.find(canonicalURL);
+        if (entry.lastModified > 0 && previous != previousUrlState.end() &&
+            readChangeHistory(*previous).lastFetched >= entry.lastModified)
+            weight = SITEMAP_UNCHANGED_WEIGHT;
 
-    for (const string& disallowed : disallowedPaths) 
+        items.push_back(FrontierItem{canonicalURL, 0, 1});
+        weights.push_back(weight);
+        totalWeight += weight;
+    }
+
+    // Like the links of a page, they are visited and queued in one commit
+    shared_lock<shared_mutex> commit(checkpointer.commits());
+    vector<FrontierItem> added;
     {
-        if (urlPath.find(disallowed) == 0) // Check if URL path starts with a disallowed path
+        lock_guard<mutex> guard(visitedMutex);
+        for (size_t i = 0; i < items.size(); i++)
         {
-            return false;
+            if (!visitedURLs.insert(items[i].url).second)
+                continue;
+            items[i].cash = SITEMAP_CASH * weights[i] / totalWeight;
+            added.push_back(move(items[i]));
         }
     }
-    return true;
+    for (const auto& item : added)
+        journal.append(journalRecord(RECORD_VISITED).str(item.url).data());
+    scheduler.push(added);
+    sitemapURLsQueued += added.size();
 }
 
 
 
-
 //FUNCTIONS TO PROCESS KEYWORDS EXTRACTION
 
 
-vector<string> processKeyWords( string text)
+// Tokenizes outside the GIL, then lemmatizes every word of the page in one Python call
+vector<string> processKeyWords(const string& text)
 {
-    // cout<< "Processing keyword from word stream";
-    vector<string> keywords;
-    py::gil_scoped_acquire acquire; 
-
-    stringstream ss(text);
-    string word;
-    while ( ss >> word )
+    vector<string> words;
+    AsciiTokenizer::local().forEachToken(text, [&](string_view token, size_t) {
+        words.emplace_back(token);
+    });
+    if (words.empty())
+        return words;
+
+    vector<string> lemmas;
     {
-        word = regex_replace(word, regex("[^a-zA-Z]"), "");
-        
-        if (word.empty()) continue;
-
+        py::gil_scoped_acquire acquire;
         try 
         {
-            py::object result = lemmatize_word(word);
-            if (stopWords.find(result.cast<string>()) == stopWords.end() )
-            {
-                string keyword = result.cast<string>();
-                for (int i = 0; i < keyword.length(); i++)
-                    keyword[i] = tolower(keyword[i]);
-                keywords.push_back(keyword);
-            }
+            lemmas = lemmatize_words(words).cast<vector<string>>();
         }
         catch( const py:: error_already_set & e )
         {
@@ -655,5 +1373,451 @@ vector<string> processKeyWords( string text)
         }
     }
 
+    vector<string> keywords;
+    for (auto& keyword : lemmas)
+    {
+        if (stopWords.find(keyword) == stopWords.end())
+            keywords.push_back(move(keyword));
+    }
     return keywords;
-}
\ No newline at end of file
+}
+
+
+
+//FUNCTIONS TO CHECKPOINT AND RESUME A CRAWL
+
+// Starts a journal record stamped with this thread's worker, built in a per-thread buffer
+RecordWriter journalRecord(JournalRecordType type)
+{
+    static thread_local string record;
+    return RecordWriter(record, type, currentWorker);
+}
+
+// Restores the crawl state as of the last checkpoint: the records before its cut are
+// replayed and copied into a fresh journal, and its frontier and budget are restored
+bool resumeCrawl()
+{
+    CrawlCheckpoint checkpoint;
+    if (!Checkpointer::read(CHECKPOINT_PATH, checkpoint))
+        return false;
+
+    string compactedPath = string(JOURNAL_PATH) + ".tmp";
+    if (!journal.open(compactedPath.c_str()))
+        return false;
+
+    uint64_t replayed = 0, discarded = 0;
+    CrawlJournal::replay(JOURNAL_PATH, UINT64_MAX, [&](uint8_t type, uint16_t, uint64_t end, string_view record, RecordReader& reader) {
+        if (end > checkpoint.journalCut) {
+            discarded++;
+            return;
+        }
+
+        if (type == RECORD_VISITED) {
+            visitedURLs.insert(string(reader.str()));
+        } else if (type == RECORD_KEYWORD) {
+            string keyword(reader.str());
+            string url(reader.str());
+            keyword_to_url_hashmap[keyword].push_back({{url, reader.f32()}});
+        } else if (type == RECORD_LINK) {
+            string from(reader.str());
+            url_to_outgoingLinks_hashmap[from].push_back(string(reader.str()));
+        } else if (type == RECORD_URL_STATE) {
+            string url(reader.str());
+            urlState[url] = json::parse(reader.str(), nullptr, false);
+        } else if (type == RECORD_DUPLICATE) {
+            string url(reader.str());
+            duplicate_to_canonical[url] = string(reader.str());
+            nearDuplicates.duplicates++;
+        } else if (type == RECORD_FINGERPRINT) {
+            string url(reader.str());
+            string canonical;
+            nearDuplicates.findOrInsert(reader.u64(), url, canonical);
+        }
+
+        if (!reader.ok()) {
+            discarded++;
+            return;
+        }
+        journal.append(record);
+        replayed++;
+    });
+
+    // Queued URLs were marked visited when they were found
+    for (const auto& item : checkpoint.frontier) {
+        visitedURLs.insert(item.url);
+        scheduler.push(item.url, item.depth, item.cash);
+    }
+    scheduler.setBudget(checkpoint.sitesRemaining);
+
+    // The compacted journal is a prefix of what the old cut covered, so the old checkpoint
+    // still describes it until the next checkpoint replaces it
+    journal.sync();
+    if (rename(compactedPath.c_str(), JOURNAL_PATH) != 0)
+        return false;
+
+    cout << "resumed: " << replayed << " journal records replayed, " << discarded << " past the checkpoint discarded, "
+         << checkpoint.frontier.size() << " URLs queued" << endl;
+    return true;
+}
+
+
+
+//FUNCTIONS TO REPROCESS ARCHIVED PAGES
+
+// Runs every response in an archive through the parse and extraction pipeline on `workers`
+// threads, with no network
+bool replayWarc(const char* path, size_t workers)
+{
+    return forEachWarcRecord(path, workers, replayRecord);
+}
+
+// Replays one archived response through the same header, parse and commit steps as a page
+// that was just fetched
+void replayRecord(const WarcRecord& record)
+{
+    if (record.type != "response" || record.targetURI.empty())
+        return;
+
+    string_view block = record.block;
+    size_t headerEnd = block.find("\r\n\r\n");
+    if (block.substr(0, 5) != "HTTP/" || headerEnd == string_view::npos)
+        return;
+    string headers(block.substr(0, headerEnd + 2));
+    string_view body = block.substr(headerEnd + 4);
+    if (atoi(headers.c_str() + headers.find(' ') + 1) != 200)
+        return;
+
+    // Archived under the URL fetched; the page's key may have dropped its trailing slash
+    string currentURL;
+    if (!UrlCanonicalizer().canonicalize(record.targetURI, record.targetURI, currentURL))
+        currentURL = string(record.targetURI);
+    string fetchURL(record.targetURI);
+    visitedMutex.lock();
+    visitedURLs.insert(currentURL);
+    visitedMutex.unlock();
+
+    PageParser page;
+    beginPage(page, fetchURL.c_str(), currentURL);
+    for (size_t start = 0, end; (end = headers.find("\r\n", start)) != string::npos; start = end + 2)
+        if (storeHeader(&headers[start], 1, end + 2 - start, &page) == 0)
+            break;
+
+    if (page.rejected != nullptr || streamHTML((void*) body.data(), 1, body.size(), &page) != body.size())
+    {
+        if (page.context != NULL)
+            htmlFreeParserCtxt(page.context);
+        return;
+    }
+
+    finishPage(page);
+    auto previous = previousUrlState.find(currentURL);
+    rememberPage(page, body.size(), previous != previousUrlState.end() ? &*previous : nullptr, record.time());
+    commitLinks(FrontierItem{currentURL, 0, 0}, page.links);
+    recordsReplayed++;
+}
+
+
+
+//FUNCTIONS TO REFRESH A PREVIOUS CRAWL
+
+double secondsSinceEpoch()
+{
+    return chrono::duration<double>(chrono::system_clock::now().time_since_epoch()).count();
+}
+
+ChangeHistory readChangeHistory(const json& state)
+{
+    ChangeHistory history;
+    history.firstFetched = state.value("firstFetched", 0.0);
+    history.lastFetched = state.value("fetched", 0.0);
+    history.checks = state.value("checks", 0u);
+    history.changes = state.value("changes", 0u);
+    return history;
+}
+
+void writeChangeHistory(json& state, const ChangeHistory& history)
+{
+    state["firstFetched"] = history.firstFetched;
+    state["fetched"] = history.lastFetched;
+    state["checks"] = history.checks;
+    state["changes"] = history.changes;
+}
+
+// Queues the pages of the last crawl most likely to have changed since they were fetched,
+// at most `pages` of them, with their change probability as their cash. Every other page
+// is carried over as it was: its keywords, state and links go straight to this crawl's
+// output. Links found on refetched pages that the last crawl never saw are queued as
+// usual and share the same budget.
+bool planRecrawl(uint64_t pages)
+{
+    if (previousUrlState.empty())
+        return false;
+
+    double now = secondsSinceEpoch();
+    vector<pair<double, string>> candidates; // change probability, url
+    for (const auto& [url, state] : previousUrlState.items())
+    {
+        visitedURLs.insert(url);
+        journal.append(journalRecord(RECORD_VISITED).str(url).data());
+
+        double probability = readChangeHistory(state).changeProbability(now, 1.0 / DEFAULT_CHANGE_INTERVAL_SECONDS);
+        if (probability >= RECRAWL_MIN_CHANGE_PROBABILITY)
+            candidates.emplace_back(probability, url);
+    }
+
+    size_t scheduled = min<size_t>(pages, candidates.size());
+    partial_sort(candidates.begin(), candidates.begin() + scheduled, candidates.end(), greater<pair<double, string>>());
+
+    unordered_set<string> refetched;
+    for (size_t i = 0; i < scheduled; i++)
+    {
+        const json& previous = previousUrlState[candidates[i].second];
+        if (previous.contains("fetchURL"))
+            fetchURLs.emplace(candidates[i].second, previous["fetchURL"].get<string>());
+        scheduler.push(candidates[i].second, 0, candidates[i].first);
+        refetched.insert(candidates[i].second);
+        recrawlExpectedChanges += candidates[i].first;
+    }
+    recrawlScheduled = scheduled;
+
+    for (const auto& [url, state] : previousUrlState.items())
+    {
+        if (refetched.count(url))
+            continue;
+        emitPreviousPage(state, url);
+        journal.append(journalRecord(RECORD_URL_STATE).str(url).str(state.dump()).data());
+        urlState[url] = state;
+        recrawlCarriedOver++;
+    }
+
+    // Links are only recorded when first found, so last crawl's stay as they were
+    ifstream linksFile("../jsonFiles/outgoingLinks.json");
+    json previousLinks = linksFile ? json::parse(linksFile, nullptr, false) : json::object();
+    if (previousLinks.is_object())
+    {
+        for (const auto& [from, links] : previousLinks.items())
+        {
+            for (const auto& link : links)
+            {
+                url_to_outgoingLinks_hashmap[from].push_back(link);
+                journal.append(journalRecord(RECORD_LINK).str(from).str(link.get<string>()).data());
+            }
+        }
+    }
+
+    scheduler.setBudget(pages);
+    return true;
+}
+
+
+
+//BENCHMARKS
+
+int benchmarkTokenizer(const char* path)
+{
+    ifstream file(path, ios::binary);
+    if (!file) {
+        cerr << "Failed to open " << path << endl;
+        return EXIT_FAILURE;
+    }
+    string text((istreambuf_iterator<char>(file)), istreambuf_iterator<char>());
+
+    // The parser hands text over one node at a time; lines stand in for text nodes
+    vector<string> nodes;
+    stringstream lines(text);
+    for (string line; getline(lines, line); )
+        nodes.push_back(line);
+
+    auto timeIt = [&](const char* name, auto&& run) {
+        const int rounds = 5;
+        size_t tokens = 0;
+        auto start = chrono::steady_clock::now();
+        for (int i = 0; i < rounds; i++)
+            tokens = run();
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count() / rounds;
+        cout << name << ": " << tokens << " tokens, " << seconds * 1000 << " ms, "
+             << text.size() / seconds / (1024 * 1024) << " MiB/s" << endl;
+    };
+
+    // What processKeyWords did per word before the tokenizer
+    timeIt("keywords (stringstream + regex)", [&]() {
+        size_t tokens = 0;
+        stringstream ss(text);
+        string word;
+        while (ss >> word) {
+            word = regex_replace(word, regex("[^a-zA-Z]"), "");
+            for (auto& c : word)
+                c = tolower(c);
+            if (!word.empty()) tokens++;
+        }
+        return tokens;
+    });
+
+    // What the word counter and the query parser did per text node
+    timeIt("words (istringstream per node)", [&]() {
+        size_t tokens = 0;
+        for (const auto& node : nodes) {
+            istringstream ss(node);
+            string word;
+            while (ss >> word) tokens++;
+        }
+        return tokens;
+    });
+
+    cout << "tokenizer kernel: " << AsciiTokenizer::kernel().name << endl;
+
+    timeIt("tokenizer (whole text)", [&]() {
+        return AsciiTokenizer::local().count(text);
+    });
+
+    timeIt("tokenizer (per node)", [&]() {
+        size_t tokens = 0;
+        for (const auto& node : nodes)
+            tokens += AsciiTokenizer::local().count(node);
+        return tokens;
+    });
+
+    return EXIT_SUCCESS;
+}
+
+// Crawls the link graph recorded in url_state.json again, offline, with a FIFO queue (the
+// old BFS) and with the OPIC frontier, and reports how much of the graph's PageRank each one
+// fetches within the page budget
+int evaluateFrontier(const char* path, const char* seed, size_t budget)
+{
+    ifstream file(path);
+    json state = json::parse(file, nullptr, false);
+    if (!state.is_object()) {
+        cerr << "Failed to read " << path << endl;
+        return EXIT_FAILURE;
+    }
+
+    // Pages are numbered; links to pages that were never fetched lead to sinks
+    unordered_map<string, uint32_t> ids;
+    vector<string> names;
+    vector<vector<uint32_t>> graph;
+    auto idOf = [&](const string& url) {
+        auto [it, inserted] = ids.try_emplace(url, names.size());
+        if (inserted) {
+            names.push_back(url);
+            graph.emplace_back();
+        }
+        return it->second;
+    };
+    size_t edges = 0;
+    for (const auto& [url, page] : state.items()) {
+        uint32_t from = idOf(url);
+        for (const auto& link : page.value("links", json::array())) {
+            uint32_t to = idOf(link.get<string>());
+            graph[from].push_back(to);
+            edges++;
+        }
+    }
+
+    string seedURL;
+    if (!UrlCanonicalizer().canonicalize(seed, seed, seedURL) || ids.find(seedURL) == ids.end()) {
+        cerr << seed << " is not a page of " << path << endl;
+        return EXIT_FAILURE;
+    }
+
+    // PageRank as the indexer computes it, sink pages spreading their rank evenly
+    size_t n = names.size();
+    const double dampingFactor = 0.85;
+    vector<double> rank(n, 1.0 / n), next(n);
+    for (int iteration = 0; iteration < 100; iteration++) {
+        double sink = 0;
+        for (size_t i = 0; i < n; i++)
+            if (graph[i].empty()) sink += rank[i];
+        fill(next.begin(), next.end(), (1 - dampingFactor) / n + dampingFactor * sink / n);
+        for (size_t i = 0; i < n; i++)
+            for (uint32_t to : graph[i])
+                next[to] += dampingFactor * rank[i] / graph[i].size();
+        double error = 0;
+        for (size_t i = 0; i < n; i++)
+            error += fabs(next[i] - rank[i]);
+        rank.swap(next);
+        if (error < 1e-9) break;
+    }
+
+    budget = min(budget, n);
+    vector<uint32_t> byRank(n);
+    for (size_t i = 0; i < n; i++) byRank[i] = i;
+    sort(byRank.begin(), byRank.end(), [&](uint32_t a, uint32_t b) { return rank[a] > rank[b]; });
+
+    // Fetch orders, each cut off at the budget
+    vector<uint32_t> bfs;
+    {
+        Queue<string> queue;
+        vector<bool> seen(n);
+        queue.push(seedURL);
+        seen[ids[seedURL]] = true;
+        while (!queue.empty() && bfs.size() < budget) {
+            uint32_t page = ids[queue.front()];
+            queue.pop();
+            bfs.push_back(page);
+            for (uint32_t to : graph[page])
+                if (!seen[to]) {
+                    seen[to] = true;
+                    queue.push(names[to]);
+                }
+        }
+    }
+
+    // The crawler's own scheduler, with politeness turned off so only priorities count
+    auto opicOrder = [&](FrontierOptions options) {
+        vector<uint32_t> order;
+        SchedulerOptions unlimited;
+        unlimited.hostDelay = 0;
+        HostScheduler simulated(unlimited, options);
+        vector<bool> seen(n);
+        vector<string> links;
+        FrontierItem item;
+        simulated.push(seedURL, 0, 1.0);
+        simulated.setBudget(budget);
+        seen[ids[seedURL]] = true;
+        while (simulated.next(item)) {
+            uint32_t page = ids[item.url];
+            order.push_back(page);
+            links.clear();
+            for (uint32_t to : graph[page]) {
+                links.push_back(names[to]);
+                if (!seen[to]) {
+                    seen[to] = true;
+                    simulated.push(names[to], item.depth + 1);
+                }
+            }
+            simulated.distribute(item.cash, links);
+            simulated.done(item);
+        }
+        return order;
+    };
+
+    FrontierOptions cashOnly;
+    cashOnly.depthWeight = 0;
+    cashOnly.hostPages = numeric_limits<double>::infinity();
+    vector<pair<const char*, vector<uint32_t>>> orders = {
+        {"bfs", bfs},
+        {"opic", opicOrder(FrontierOptions())},
+        {"opic (cash only)", opicOrder(cashOnly)},
+    };
+
+    cout << "link graph: " << state.size() << " pages fetched, " << n << " URLs, " << edges << " links" << endl;
+    for (size_t pages : {budget / 4, budget / 2, budget}) {
+        if (pages == 0) continue;
+        unordered_set<uint32_t> top(byRank.begin(), byRank.begin() + pages);
+        cout << "after " << pages << " pages:" << endl;
+        for (const auto& [name, order] : orders) {
+            size_t fetched = min(pages, order.size());
+            size_t covered = 0;
+            double mass = 0;
+            for (size_t i = 0; i < fetched; i++) {
+                covered += top.count(order[i]);
+                mass += rank[order[i]];
+            }
+            cout << "  " << name << ": " << 100.0 * covered / pages << "% of the top " << pages
+                 << " PageRank pages, " << 100.0 * mass << "% of all PageRank" << endl;
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,110 @@
+#ifndef _CURL_SHARE_H_
+#define _CURL_SHARE_H_
+
+#include <mutex>
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+#include <algorithm>
+#include <curl/curl.h>
+
+// DNS cache, TLS sessions and the connection pool shared by every crawler worker's easy
+// handle, so a host resolved, connected to or handshaken with by one worker is reused by
+// the others. libcurl calls back into lock()/unlock() around each shared structure.
+class CurlShare {
+private:
+    CURLSH* share;
+    std::mutex locks[CURL_LOCK_DATA_LAST];
+
+    static void lock(CURL*, curl_lock_data data, curl_lock_access, void* userData) {
+        ((CurlShare*) userData)->locks[data].lock();
+    }
+
+    static void unlock(CURL*, curl_lock_data data, void* userData) {
+        ((CurlShare*) userData)->locks[data].unlock();
+    }
+
+public:
+    CurlShare() {
+        curl_global_init(CURL_GLOBAL_DEFAULT);
+        share = curl_share_init();
+        if (share == nullptr) return;
+
+        curl_share_setopt(share, CURLSHOPT_LOCKFUNC, lock);
+        curl_share_setopt(share, CURLSHOPT_UNLOCKFUNC, unlock);
+        curl_share_setopt(share, CURLSHOPT_USERDATA, this);
+        curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+        curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+        curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_CONNECT);
+    }
+
+    CurlShare(const CurlShare&) = delete;
+    CurlShare& operator=(const CurlShare&) = delete;
+
+    // Every easy handle attached must be cleaned up before the share is destroyed
+    ~CurlShare() {
+        if (share != nullptr) curl_share_cleanup(share);
+        curl_global_cleanup();
+    }
+
+    void attach(CURL* curl) {
+        if (share != nullptr) curl_easy_setopt(curl, CURLOPT_SHARE, share);
+    }
+};
+
+// Where the time of each transfer went, summed over all workers. A transfer that opened no
+// new connection reused a pooled one; a new connection whose name lookup was instant was
+// served from the shared DNS cache.
+struct TransferStats {
+    std::atomic<uint64_t> transfers{0};
+    std::atomic<uint64_t> newConnections{0};
+    std::atomic<uint64_t> dnsLookups{0};
+    std::atomic<uint64_t> tlsHandshakes{0};
+    std::atomic<uint64_t> dnsMicros{0};
+    std::atomic<uint64_t> connectMicros{0};
+    std::atomic<uint64_t> tlsMicros{0};
+    std::atomic<uint64_t> totalMicros{0};
+
+    //name lookups faster than this were answered from the DNS cache
+    static const curl_off_t cachedLookupMicros = 100;
+
+    void record(CURL* curl) {
+        long connects = 0;
+        curl_off_t nameLookup = 0, connect = 0, appConnect = 0, total = 0;
+        curl_easy_getinfo(curl, CURLINFO_NUM_CONNECTS, &connects);
+        curl_easy_getinfo(curl, CURLINFO_NAMELOOKUP_TIME_T, &nameLookup);
+        curl_easy_getinfo(curl, CURLINFO_CONNECT_TIME_T, &connect);
+        curl_easy_getinfo(curl, CURLINFO_APPCONNECT_TIME_T, &appConnect);
+        curl_easy_getinfo(curl, CURLINFO_TOTAL_TIME_T, &total);
+
+        transfers.fetch_add(1, std::memory_order_relaxed);
+        totalMicros.fetch_add(total, std::memory_order_relaxed);
+        if (connects == 0) return;
+
+        // The timings are cumulative from the start of the transfer
+        newConnections.fetch_add(connects, std::memory_order_relaxed);
+        if (nameLookup > cachedLookupMicros) dnsLookups.fetch_add(1, std::memory_order_relaxed);
+        dnsMicros.fetch_add(nameLookup, std::memory_order_relaxed);
+        if (connect > nameLookup) connectMicros.fetch_add(connect - nameLookup, std::memory_order_relaxed);
+        if (appConnect > connect) {
+            tlsHandshakes.fetch_add(1, std::memory_order_relaxed);
+            tlsMicros.fetch_add(appConnect - connect, std::memory_order_relaxed);
+        }
+    }
+
+    void report(std::ostream& out) const {
+        uint64_t count = transfers.load();
+        if (count == 0) return;
+        auto percent = [count](uint64_t part) { return 100.0 * part / count; };
+        auto perPage = [count](uint64_t micros) { return micros / 1000.0 / count; };
+
+        out << "transfers: " << count
+            << ", connections reused " << percent(count - std::min<uint64_t>(newConnections, count)) << "%"
+            << ", DNS lookups " << dnsLookups << " (" << percent(count - std::min<uint64_t>(dnsLookups, count)) << "% cached)"
+            << ", TLS handshakes " << tlsHandshakes << "\n"
+            << "per page: dns " << perPage(dnsMicros) << " ms, connect " << perPage(connectMicros)
+            << " ms, tls " << perPage(tlsMicros) << " ms, total " << perPage(totalMicros) << " ms" << std::endl;
+    }
+};
+
+#endif
@@ -0,0 +1,204 @@
+#ifndef _FRONTIER_H_
+#define _FRONTIER_H_
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include <string_view>
+#include <unordered_map>
+
+// Terms that temper a URL's cash into its crawl priority
+struct FrontierOptions {
+    double depthWeight = 0.1;  // priority is divided by 1 + depthWeight * depth
+    double hostPages = 100;    // a host's priorities halve after every hostPages pages fetched from it
+};
+
+// A queued URL as the frontier hands it out (and as checkpoints store it)
+struct FrontierItem {
+    std::string url;
+    double cash = 0;
+    uint32_t depth = 0;
+};
+
+// Priority frontier using OPIC (Abiteboul et al., "Adaptive On-Line Page Importance
+// Computation"): every fetched page hands its cash out in equal shares to the links on it,
+// so a queued URL's cash grows with the importance of the pages that link to it, and the
+// richest URL is fetched first. URLs are grouped by host, each host with a lazy max-heap: a
+// credit pushes a fresh node with a new version and leaves the old one to be skipped when it
+// surfaces. Not synchronized; the HostScheduler that owns it does the locking.
+class Frontier {
+private:
+    struct Entry {
+        double cash;
+        uint32_t depth;
+        uint32_t host;
+        uint64_t version;
+    };
+
+    struct Node {
+        double priority;
+        uint64_t version;
+        std::string url;
+
+        bool operator<(const Node& other) const {
+            return priority < other.priority;
+        }
+    };
+
+    struct Host {
+        std::string name;
+        std::vector<Node> heap;
+        size_t queued = 0;  // live entries
+        uint32_t pages = 0; // URLs popped so far
+    };
+
+    FrontierOptions options;
+    std::unordered_map<std::string, Entry> entries;
+    std::unordered_map<std::string, uint32_t> hostIds;
+    std::vector<Host> hosts;
+    uint64_t nextVersion = 0;
+
+    double priority(const Entry& entry) const {
+        return entry.cash / (1 + options.depthWeight * entry.depth) / (1 + hosts[entry.host].pages / options.hostPages);
+    }
+
+    void pushNode(const std::string& url, Entry& entry) {
+        entry.version = ++nextVersion;
+        Host& host = hosts[entry.host];
+        host.heap.push_back(Node{priority(entry), entry.version, url});
+        std::push_heap(host.heap.begin(), host.heap.end());
+
+        // Stale nodes are dropped once they outnumber the live ones
+        if (host.heap.size() > 2 * host.queued + 64) compact(host);
+    }
+
+    bool stale(const Node& node) const {
+        auto it = entries.find(node.url);
+        return it == entries.end() || it->second.version != node.version;
+    }
+
+    void compact(Host& host) {
+        host.heap.erase(std::remove_if(host.heap.begin(), host.heap.end(),
+                                       [this](const Node& node) { return stale(node); }),
+                        host.heap.end());
+        std::make_heap(host.heap.begin(), host.heap.end());
+    }
+
+public:
+    explicit Frontier(FrontierOptions options = FrontierOptions()) : options(options) {}
+
+    static std::string_view hostName(std::string_view url) {
+        size_t start = url.find("://");
+        start = start == std::string_view::npos ? 0 : start + 3;
+        size_t end = url.find_first_of("/?#", start);
+        return url.substr(start, end == std::string_view::npos ? std::string_view::npos : end - start);
+    }
+
+    // Id of the url's host, assigned the first time the host is seen
+    uint32_t hostOf(std::string_view url) {
+        std::string name(hostName(url));
+        auto [it, inserted] = hostIds.try_emplace(name, hosts.size());
+        if (inserted) {
+            hosts.emplace_back();
+            hosts.back().name = std::move(name);
+        }
+        return it->second;
+    }
+
+    // Queues url and returns its host; a URL that is already queued only receives the cash
+    uint32_t push(const std::string& url, uint32_t depth, double cash = 0) {
+        auto it = entries.find(url);
+        if (it == entries.end()) {
+            uint32_t host = hostOf(url);
+            it = entries.emplace(url, Entry{0, depth, host, 0}).first;
+            hosts[host].queued++;
+        }
+        it->second.cash += cash;
+        pushNode(it->first, it->second);
+        return it->second.host;
+    }
+
+    // Gives a fetched page's cash to its links in equal shares and calls credited(host) for
+    // each queued link. Links that are not queued (already fetched, or filtered) let their
+    // share go.
+    template <typename Credited>
+    void distribute(double cash, const std::vector<std::string>& links, Credited&& credited) {
+        if (links.empty() || cash <= 0) return;
+        double share = cash / links.size();
+        for (const auto& link : links) {
+            auto it = entries.find(link);
+            if (it == entries.end()) continue;
+            it->second.cash += share;
+            pushNode(it->first, it->second);
+            credited(it->second.host);
+        }
+    }
+
+    // Current priority of the host's best URL, or a negative value when it has none. Stale
+    // nodes on top are discarded, and one whose priority dropped since it was pushed (its
+    // host has been fetched from since) is put back at its current priority.
+    double topPriority(uint32_t id) {
+        Host& host = hosts[id];
+        while (!host.heap.empty()) {
+            const Node& top = host.heap.front();
+            auto it = entries.find(top.url);
+            if (it == entries.end() || it->second.version != top.version) {
+                std::pop_heap(host.heap.begin(), host.heap.end());
+                host.heap.pop_back();
+                continue;
+            }
+            double current = priority(it->second);
+            if (current >= top.priority) return current;
+
+            std::pop_heap(host.heap.begin(), host.heap.end());
+            host.heap.back().priority = current;
+            std::push_heap(host.heap.begin(), host.heap.end());
+        }
+        return -1;
+    }
+
+    // Takes the host's best URL
+    bool pop(uint32_t id, FrontierItem& item) {
+        if (topPriority(id) < 0) return false;
+        Host& host = hosts[id];
+        std::pop_heap(host.heap.begin(), host.heap.end());
+        Node node = std::move(host.heap.back());
+        host.heap.pop_back();
+
+        auto it = entries.find(node.url);
+        item.url = std::move(node.url);
+        item.cash = it->second.cash;
+        item.depth = it->second.depth;
+        entries.erase(it);
+        host.queued--;
+        host.pages++;
+        return true;
+    }
+
+    size_t size() const {
+        return entries.size();
+    }
+
+    size_t queued(uint32_t host) const {
+        return hosts[host].queued;
+    }
+
+    size_t hostCount() const {
+        return hosts.size();
+    }
+
+    // Calls fn(item) on every queued URL, in no particular order
+    template <typename Fn>
+    void forEach(Fn&& fn) const {
+        FrontierItem item;
+        for (const auto& [url, entry] : entries) {
+            item.url = url;
+            item.cash = entry.cash;
+            item.depth = entry.depth;
+            fn(item);
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,290 @@
+#ifndef _HOST_SCHEDULER_H_
+#define _HOST_SCHEDULER_H_
+
+#include <mutex>
+#include <queue>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include <functional>
+#include <unordered_map>
+#include <condition_variable>
+
+#include "frontier.hpp"
+
+// How hard any one host is crawled
+struct SchedulerOptions {
+    double hostDelay = 0.25;   // seconds between requests to a host that sets no Crawl-delay
+    double burst = 4;          // requests such a host may get back to back after a quiet spell
+    double maxCrawlDelay = 30; // longest Crawl-delay honoured
+};
+
+// Hands URLs to a pool of workers so that every host is crawled politely and no worker sits
+// idle while some host could be fetched from. Each host has a token bucket refilled at its
+// allowed rate (1 / Crawl-delay, or 1 / hostDelay) and at most one request in flight. Hosts
+// that must wait sit in a min-heap keyed by the time their next token arrives; hosts that
+// may be fetched from now sit in a max-heap keyed by the priority of their best URL, so a
+// worker always gets the most important URL that politeness allows. Throughput grows with
+// the number of distinct hosts while each host's load stays bounded by its bucket.
+class HostScheduler {
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    struct HostState {
+        double rate = 0;           // tokens per second, 0 for unlimited
+        double capacity = 1;
+        double tokens = 0;
+        Clock::time_point refilled;
+        bool busy = false;         // a request to the host is in flight
+        bool ready = false;        // in the ready heap
+        bool waiting = false;      // in the waiting heap
+        uint64_t version = 0;      // ready heap nodes with another version are stale
+    };
+
+    struct ReadyNode {
+        double priority;
+        uint64_t version;
+        uint32_t host;
+
+        bool operator<(const ReadyNode& other) const {
+            return priority < other.priority;
+        }
+    };
+
+    struct WaitingNode {
+        Clock::time_point time;
+        uint32_t host;
+
+        bool operator>(const WaitingNode& other) const {
+            return time > other.time;
+        }
+    };
+
+    SchedulerOptions options;
+    Frontier frontier;
+    std::mutex schedulerMutex;
+    std::condition_variable changed;
+    std::vector<HostState> hosts; // indexed like the frontier's host ids
+    std::vector<ReadyNode> ready;
+    size_t readyHosts = 0;
+    std::priority_queue<WaitingNode, std::vector<WaitingNode>, std::greater<WaitingNode>> waiting;
+    std::unordered_map<std::string, FrontierItem> inFlight;
+    uint64_t budget;
+    bool stopping = false;
+
+    HostState& state(uint32_t host) {
+        while (hosts.size() <= host) {
+            HostState fresh;
+            setRate(fresh, options.hostDelay, options.burst);
+            fresh.tokens = fresh.capacity;
+            fresh.refilled = Clock::now();
+            hosts.push_back(fresh);
+        }
+        return hosts[host];
+    }
+
+    static void setRate(HostState& host, double delay, double burst) {
+        host.rate = delay > 0 ? 1 / delay : 0;
+        host.capacity = std::max(1.0, burst);
+        host.tokens = std::min(host.tokens, host.capacity);
+    }
+
+    void refill(HostState& host, Clock::time_point now) {
+        if (host.rate == 0) {
+            host.tokens = host.capacity;
+        } else {
+            double elapsed = std::chrono::duration<double>(now - host.refilled).count();
+            host.tokens = std::min(host.capacity, host.tokens + elapsed * host.rate);
+        }
+        host.refilled = now;
+    }
+
+    // Files an idle host under ready or waiting, depending on its bucket
+    void schedule(uint32_t id, Clock::time_point now) {
+        HostState& host = state(id);
+        if (host.busy || host.ready || host.waiting || frontier.queued(id) == 0) return;
+
+        refill(host, now);
+        if (host.tokens >= 1) {
+            host.ready = true;
+            readyHosts++;
+            pushReady(id);
+        } else {
+            auto wait = std::chrono::duration<double>((1 - host.tokens) / host.rate);
+            waiting.push(WaitingNode{now + std::chrono::duration_cast<Clock::duration>(wait), id});
+            host.waiting = true;
+        }
+        changed.notify_one();
+    }
+
+    void pushReady(uint32_t id) {
+        ready.push_back(ReadyNode{frontier.topPriority(id), ++hosts[id].version, id});
+        std::push_heap(ready.begin(), ready.end());
+
+        // Stale nodes are dropped once they outnumber the ready hosts
+        if (ready.size() > 2 * readyHosts + 1024) {
+            ready.erase(std::remove_if(ready.begin(), ready.end(), [this](const ReadyNode& node) {
+                return !hosts[node.host].ready || hosts[node.host].version != node.version;
+            }), ready.end());
+            std::make_heap(ready.begin(), ready.end());
+        }
+    }
+
+    // A ready host's best URL changed; its old ready node goes stale
+    void reprioritize(uint32_t id) {
+        if (state(id).ready) pushReady(id);
+    }
+
+public:
+    std::atomic<uint64_t> idleMicros{0}; // time workers spent waiting for a host to become ready
+
+    explicit HostScheduler(SchedulerOptions options = SchedulerOptions(), FrontierOptions frontierOptions = FrontierOptions())
+        : options(options), frontier(frontierOptions), budget(UINT64_MAX) {}
+
+    void setOptions(SchedulerOptions schedulerOptions) {
+        std::lock_guard<std::mutex> guard(schedulerMutex);
+        options = schedulerOptions;
+    }
+
+    // At most this many more URLs are handed out
+    void setBudget(uint64_t pages) {
+        std::lock_guard<std::mutex> guard(schedulerMutex);
+        budget = pages;
+        changed.notify_all();
+    }
+
+    void push(const std::string& url, uint32_t depth, double cash = 0) {
+        std::lock_guard<std::mutex> guard(schedulerMutex);
+        uint32_t host = frontier.push(url, depth, cash);
+        if (state(host).ready)
+            reprioritize(host);
+        else
+            schedule(host, Clock::now());
+    }
+
+    // Queues a batch of URLs, such as a sitemap's, under one lock; each host they touch is
+    // rescheduled once
+    void push(const std::vector<FrontierItem>& items) {
+        std::lock_guard<std::mutex> guard(schedulerMutex);
+        std::vector<uint32_t> touched;
+        for (const auto& item : items) {
+            uint32_t host = frontier.push(item.url, item.depth, item.cash);
+            if (touched.empty() || touched.back() != host) touched.push_back(host);
+        }
+        std::sort(touched.begin(), touched.end());
+        touched.erase(std::unique(touched.begin(), touched.end()), touched.end());
+
+        auto now = Clock::now();
+        for (uint32_t host : touched) {
+            if (state(host).ready)
+                reprioritize(host);
+            else
+                schedule(host, now);
+        }
+    }
+
+    void distribute(double cash, const std::vector<std::string>& links) {
+        std::lock_guard<std::mutex> guard(schedulerMutex);
+        frontier.distribute(cash, links, [this](uint32_t host) { reprioritize(host); });
+    }
+
+    // Applies a host's robots.txt Crawl-delay, or the default rate when it sets none
+    void setCrawlDelay(const std::string& url, double delay) {
+        std::lock_guard<std::mutex> guard(schedulerMutex);
+        HostState& host = state(frontier.hostOf(url));
+        delay = delay > 0 ? std::min(delay, options.maxCrawlDelay) : 0;
+        double rate = delay > 0 ? 1 / delay : 0;
+        if (delay > 0 && host.rate != rate) {
+            setRate(host, delay, 1);
+            host.tokens = std::min(host.tokens, 0.0); // the request in flight used this period's token
+        } else if (delay == 0) {
+            setRate(host, options.hostDelay, options.burst);
+        }
+    }
+
+    // Blocks until some host may be fetched from and takes its best URL. Returns false once
+    // the budget is spent, or when nothing is queued and nothing is in flight that could
+    // queue more.
+    bool next(FrontierItem& item) {
+        std::unique_lock<std::mutex> lock(schedulerMutex);
+        while (true) {
+            if (stopping || budget == 0) return false;
+
+            auto now = Clock::now();
+            while (!waiting.empty() && waiting.top().time <= now) {
+                uint32_t id = waiting.top().host;
+                waiting.pop();
+                hosts[id].waiting = false;
+                schedule(id, now);
+            }
+
+            while (!ready.empty()) {
+                std::pop_heap(ready.begin(), ready.end());
+                ReadyNode node = ready.back();
+                ready.pop_back();
+
+                HostState& host = hosts[node.host];
+                if (!host.ready || node.version != host.version) continue;
+                host.ready = false;
+                readyHosts--;
+                if (!frontier.pop(node.host, item)) continue;
+
+                refill(host, now);
+                host.tokens -= 1;
+                host.busy = true;
+                budget--;
+                inFlight[item.url] = item;
+                return true;
+            }
+
+            if (frontier.size() == 0 && inFlight.empty()) {
+                changed.notify_all();
+                return false;
+            }
+
+            auto start = Clock::now();
+            if (!waiting.empty())
+                changed.wait_until(lock, waiting.top().time);
+            else
+                changed.wait(lock);
+            idleMicros.fetch_add(std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start).count(),
+                                 std::memory_order_relaxed);
+        }
+    }
+
+    // The worker is finished with item; its host may be fetched from again once its bucket allows
+    void done(const FrontierItem& item) {
+        std::lock_guard<std::mutex> guard(schedulerMutex);
+        inFlight.erase(item.url);
+        uint32_t id = frontier.hostOf(item.url);
+        state(id).busy = false;
+        schedule(id, Clock::now());
+        changed.notify_all(); // the crawl may be over
+    }
+
+    void stop() {
+        std::lock_guard<std::mutex> guard(schedulerMutex);
+        stopping = true;
+        changed.notify_all();
+    }
+
+    // Every URL still to be fetched, counting those in flight, and the budget they may use
+    void snapshot(std::vector<FrontierItem>& items, uint64_t& remaining) {
+        std::lock_guard<std::mutex> guard(schedulerMutex);
+        items.clear();
+        frontier.forEach([&](const FrontierItem& item) { items.push_back(item); });
+        for (const auto& [url, item] : inFlight)
+            items.push_back(item);
+        remaining = budget == UINT64_MAX ? budget : budget + inFlight.size();
+    }
+
+    size_t hostCount() {
+        std::lock_guard<std::mutex> guard(schedulerMutex);
+        return frontier.hostCount();
+    }
+};
+
+#endif
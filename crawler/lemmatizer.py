@@ -8,6 +8,10 @@ def lemmatize_word(word):
     doc = nlp(word)
     return [token.lemma_ for token in doc][0]
 
+# Lemmatizes every keyword of a page in one call so the caller only takes the GIL once
+def lemmatize_words(words):
+    return [[token.lemma_ for token in doc][0] for doc in nlp.pipe(words)]
+
 # import spacy
 # nlp = spacy.load("en_core_web_sm")
 # doc = nlp("Hello, world!")
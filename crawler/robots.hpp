@@ -0,0 +1,295 @@
+#ifndef _ROBOTS_H_
+#define _ROBOTS_H_
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <strings.h>
+#include <unordered_map>
+#include <condition_variable>
+
+//how long a host's robots.txt is trusted before it is fetched again
+#define ROBOTS_TTL_SECONDS (24 * 60 * 60)
+//hosts whose robots.txt could not be fetched are retried sooner
+#define ROBOTS_ERROR_TTL_SECONDS (60 * 60)
+//expired entries are swept once the cache holds this many hosts
+#define ROBOTS_CACHE_SWEEP 4096
+
+// One host's robots.txt rules, compiled into a trie over the rule
+// patterns. '*' becomes an edge into a node that loops on any byte, so a path is matched
+// by walking the trie once; without wildcards the walk is a single path, O(path length).
+// The longest matching pattern decides, and Allow wins a tie (RFC 9309).
+class RobotsRules {
+private:
+    struct Node {
+        std::vector<std::pair<unsigned char, uint32_t>> children;
+        int32_t star = -1;          // child reached through '*'
+        bool loops = false;         // this node was reached through '*' and matches any byte
+        int32_t prefixLength = -1;  // longest rule ending here, matches any remainder
+        bool prefixAllow = false;
+        int32_t exactLength = -1;   // longest rule ending here with '$'
+        bool exactAllow = false;
+    };
+
+    std::vector<Node> nodes;
+    bool hasWildcards = false;
+
+    int32_t child(uint32_t node, unsigned char c) const {
+        for (const auto& [byte, next] : nodes[node].children)
+            if (byte == c) return next;
+        return -1;
+    }
+
+    uint32_t addChild(uint32_t node, unsigned char c) {
+        int32_t existing = child(node, c);
+        if (existing >= 0) return existing;
+        nodes.push_back(Node());
+        nodes[node].children.push_back({c, (uint32_t)(nodes.size() - 1)});
+        return nodes.size() - 1;
+    }
+
+    uint32_t addStar(uint32_t node) {
+        if (nodes[node].star < 0) {
+            nodes.push_back(Node());
+            nodes[node].star = nodes.size() - 1;
+            nodes.back().loops = true;
+        }
+        return nodes[node].star;
+    }
+
+    static void consider(int32_t length, bool allow, int32_t& bestLength, bool& bestAllow) {
+        if (length > bestLength || (length == bestLength && allow)) {
+            bestLength = length;
+            bestAllow = allow;
+        }
+    }
+
+    // Adds the node and the star nodes reachable from it without consuming a byte
+    void addState(uint32_t node, std::vector<uint32_t>& states) const {
+        while (true) {
+            for (uint32_t state : states)
+                if (state == node) return;
+            states.push_back(node);
+            if (nodes[node].star < 0) return;
+            node = nodes[node].star;
+        }
+    }
+
+public:
+    double crawlDelay = 0;             // seconds between requests, 0 when unset
+    std::vector<std::string> sitemaps; // Sitemap: lines, which apply to every agent
+
+    RobotsRules() : nodes(1) {}
+
+    void addRule(std::string_view pattern, bool allow) {
+        // a trailing '$' anchors the pattern at the end of the path
+        bool exact = !pattern.empty() && pattern.back() == '$';
+        int32_t length = pattern.length();
+        if (exact) pattern.remove_suffix(1);
+
+        uint32_t node = 0;
+        for (char c : pattern) {
+            if (c == '*') {
+                node = addStar(node);
+                hasWildcards = true;
+            } else {
+                node = addChild(node, c);
+            }
+        }
+
+        Node& last = nodes[node];
+        if (exact) {
+            if (length > last.exactLength || (length == last.exactLength && allow)) {
+                last.exactLength = length;
+                last.exactAllow = allow;
+            }
+        } else if (length > last.prefixLength || (length == last.prefixLength && allow)) {
+            last.prefixLength = length;
+            last.prefixAllow = allow;
+        }
+    }
+
+    bool empty() const {
+        return nodes.size() == 1;
+    }
+
+    // path is everything after the host, including the query string
+    bool allowed(std::string_view path) const {
+        if (empty()) return true;
+        if (path.empty()) path = "/";
+
+        int32_t bestLength = -1;
+        bool bestAllow = true;
+
+        if (!hasWildcards) {
+            uint32_t node = 0;
+            for (size_t i = 0; ; ++i) {
+                const Node& current = nodes[node];
+                consider(current.prefixLength, current.prefixAllow, bestLength, bestAllow);
+                if (i == path.length()) {
+                    consider(current.exactLength, current.exactAllow, bestLength, bestAllow);
+                    break;
+                }
+                int32_t next = child(node, path[i]);
+                if (next < 0) break;
+                node = next;
+            }
+            return bestAllow;
+        }
+
+        // With wildcards the trie is walked as an NFA; the set of live states stays
+        // small because only star nodes survive a mismatch
+        static thread_local std::vector<uint32_t> states, nextStates;
+        states.clear();
+        addState(0, states);
+
+        for (size_t i = 0; i <= path.length() && !states.empty(); ++i) {
+            nextStates.clear();
+            for (uint32_t state : states) {
+                const Node& current = nodes[state];
+                consider(current.prefixLength, current.prefixAllow, bestLength, bestAllow);
+                if (i == path.length()) {
+                    consider(current.exactLength, current.exactAllow, bestLength, bestAllow);
+                    continue;
+                }
+                if (current.loops) addState(state, nextStates);
+                int32_t next = child(state, path[i]);
+                if (next >= 0) addState(next, nextStates);
+            }
+            states.swap(nextStates);
+        }
+
+        return bestAllow;
+    }
+};
+
+// Parses a robots.txt body, keeping the rules of the '*' groups (the crawler has never
+// had an agent name of its own). Directive names are case-insensitive.
+inline std::unique_ptr<RobotsRules> parseRobotsRules(std::string_view content) {
+    auto rules = std::make_unique<RobotsRules>();
+    bool inGlobalGroup = false;
+    bool groupHasRules = false; // a User-agent line after rules starts a new group
+
+    auto trim = [](std::string_view s) {
+        while (!s.empty() && (s.front() == ' ' || s.front() == '\t')) s.remove_prefix(1);
+        while (!s.empty() && (s.back() == ' ' || s.back() == '\t' || s.back() == '\r')) s.remove_suffix(1);
+        return s;
+    };
+    auto is = [](std::string_view key, const char* name) {
+        return key.length() == strlen(name) && strncasecmp(key.data(), name, key.length()) == 0;
+    };
+
+    while (!content.empty()) {
+        size_t end = content.find('\n');
+        std::string_view line = content.substr(0, end);
+        content.remove_prefix(end == std::string_view::npos ? content.length() : end + 1);
+
+        size_t comment = line.find('#');
+        if (comment != std::string_view::npos) line = line.substr(0, comment);
+        size_t colon = line.find(':');
+        if (colon == std::string_view::npos) continue;
+
+        std::string_view key = trim(line.substr(0, colon));
+        std::string_view value = trim(line.substr(colon + 1));
+
+        if (is(key, "user-agent")) {
+            if (groupHasRules) {
+                inGlobalGroup = false;
+                groupHasRules = false;
+            }
+            if (value == "*") inGlobalGroup = true;
+        } else if (is(key, "sitemap")) {
+            if (!value.empty()) rules->sitemaps.emplace_back(value);
+        } else if (is(key, "allow") || is(key, "disallow")) {
+            groupHasRules = true;
+            if (value.empty()) continue; // "Disallow:" with no path allows everything
+            if (inGlobalGroup) rules->addRule(value, is(key, "allow"));
+        } else if (is(key, "crawl-delay")) {
+            groupHasRules = true;
+            double delay = strtod(std::string(value).c_str(), nullptr);
+            if (inGlobalGroup && delay > 0) rules->crawlDelay = delay;
+        }
+    }
+
+    return rules;
+}
+
+// robots.txt rules shared by every crawler thread, keyed by origin (scheme://host[:port]).
+// Each origin is fetched at most once per TTL: a thread that asks for an origin another
+// thread is already fetching waits for that fetch instead of starting its own.
+class RobotsCache {
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    struct Entry {
+        std::shared_ptr<const RobotsRules> rules; // null while a fetch is in flight
+        Clock::time_point expires;
+    };
+
+    std::mutex cacheMutex;
+    std::condition_variable fetched;
+    std::unordered_map<std::string, Entry> entries;
+
+    void sweep(Clock::time_point now) {
+        for (auto it = entries.begin(); it != entries.end(); ) {
+            if (it->second.rules && it->second.expires <= now)
+                it = entries.erase(it);
+            else
+                ++it;
+        }
+    }
+
+public:
+    std::atomic<uint64_t> hits{0};
+    std::atomic<uint64_t> fetches{0};
+
+    // fetch(origin) returns the parsed rules, or null when robots.txt could not be
+    // retrieved (the host is then treated as allowing everything for a shorter TTL)
+    template <typename Fetch>
+    std::shared_ptr<const RobotsRules> get(const std::string& origin, Fetch&& fetch) {
+        std::unique_lock<std::mutex> lock(cacheMutex);
+        while (true) {
+            auto now = Clock::now();
+            auto it = entries.find(origin);
+            if (it == entries.end() || (it->second.rules && it->second.expires <= now))
+                break;
+            if (it->second.rules) {
+                hits.fetch_add(1, std::memory_order_relaxed);
+                return it->second.rules;
+            }
+            fetched.wait(lock);
+        }
+
+        if (entries.size() >= ROBOTS_CACHE_SWEEP) sweep(Clock::now());
+        entries[origin] = Entry{nullptr, Clock::time_point()};
+        lock.unlock();
+
+        std::shared_ptr<const RobotsRules> rules;
+        int ttl = ROBOTS_TTL_SECONDS;
+        try {
+            rules = fetch(origin);
+        } catch (...) {
+            rules = nullptr;
+        }
+        if (!rules) {
+            rules = std::make_shared<RobotsRules>();
+            ttl = ROBOTS_ERROR_TTL_SECONDS;
+        }
+        fetches.fetch_add(1, std::memory_order_relaxed);
+
+        lock.lock();
+        entries[origin] = Entry{rules, Clock::now() + std::chrono::seconds(ttl)};
+        lock.unlock();
+        fetched.notify_all();
+        return rules;
+    }
+};
+
+#endif
@@ -0,0 +1,224 @@
+#ifndef _SITEMAP_H_
+#define _SITEMAP_H_
+
+#include <string>
+#include <vector>
+#include <cstring>
+#include <ctime>
+#include <string_view>
+
+#include <zlib.h>
+#include <libxml/parser.h>
+
+//a sitemap may hold at most this much XML once decompressed (sitemaps.org)
+#define MAX_SITEMAP_BYTES (50 * 1024 * 1024)
+//longest <loc> or <lastmod> kept
+#define MAX_SITEMAP_TEXT 2048
+
+// A page listed in a sitemap, with its <lastmod> in seconds since the epoch (0 when absent)
+struct SitemapEntry {
+    std::string url;
+    double lastModified = 0;
+};
+
+// Parses a sitemap or sitemap index (sitemaps.org protocol) as it downloads. Bytes go
+// straight into a libxml2 push parser in SAX mode, through zlib first when the file is
+// gzipped, so a 50 MB sitemap never sits in memory. <url> entries land in urls and the
+// <sitemap> entries of an index in sitemaps.
+class SitemapParser {
+private:
+    enum Element { OTHER, URL, SITEMAP };
+
+    xmlParserCtxtPtr context = nullptr;
+    z_stream inflater;
+    bool sniffed = false;  // first bytes looked at for the gzip magic
+    bool gzipped = false;
+    bool failed = false;
+    size_t xmlBytes = 0;
+
+    Element entry = OTHER; // <url> or <sitemap> being read
+    int depth = 0;         // elements open
+    int entryDepth = 0;    // depth of the entry's children; <image:loc> and the like sit deeper
+    std::string* text = nullptr; // field receiving character data
+    std::string loc;
+    std::string lastmod;
+
+    static bool is(const xmlChar* name, const char* expected) {
+        // sitemaps are namespaced; a prefixed name still ends in the local name
+        const char* local = strrchr((const char*) name, ':');
+        return strcmp(local ? local + 1 : (const char*) name, expected) == 0;
+    }
+
+    static void onStartElement(void* ctx, const xmlChar* name, const xmlChar**) {
+        SitemapParser* parser = (SitemapParser*) ctx;
+        parser->depth++;
+        if (parser->entry == OTHER && (is(name, "url") || is(name, "sitemap"))) {
+            parser->entry = is(name, "url") ? URL : SITEMAP;
+            parser->entryDepth = parser->depth + 1;
+            parser->loc.clear();
+            parser->lastmod.clear();
+        } else if (parser->entry != OTHER && parser->depth == parser->entryDepth) {
+            if (is(name, "loc"))
+                parser->text = &parser->loc;
+            else if (is(name, "lastmod"))
+                parser->text = &parser->lastmod;
+        }
+    }
+
+    static void onEndElement(void* ctx, const xmlChar*) {
+        SitemapParser* parser = (SitemapParser*) ctx;
+        parser->text = nullptr;
+        if (parser->depth-- != parser->entryDepth - 1 || parser->entry == OTHER)
+            return;
+
+        std::string_view loc = trim(parser->loc);
+        if (!loc.empty()) {
+            if (parser->entry == URL)
+                parser->urls.push_back(SitemapEntry{std::string(loc), parseW3CDate(trim(parser->lastmod))});
+            else
+                parser->sitemaps.emplace_back(loc);
+        }
+        parser->entry = OTHER;
+    }
+
+    static void onCharacters(void* ctx, const xmlChar* characters, int length) {
+        SitemapParser* parser = (SitemapParser*) ctx;
+        if (parser->text != nullptr && parser->text->length() + length <= MAX_SITEMAP_TEXT)
+            parser->text->append((const char*) characters, length);
+    }
+
+    static std::string_view trim(std::string_view s) {
+        while (!s.empty() && (unsigned char) s.front() <= ' ') s.remove_prefix(1);
+        while (!s.empty() && (unsigned char) s.back() <= ' ') s.remove_suffix(1);
+        return s;
+    }
+
+    void parse(const char* xml, size_t length) {
+        xmlBytes += length;
+        if (xmlBytes > MAX_SITEMAP_BYTES) {
+            failed = true;
+            return;
+        }
+        if (context == nullptr) {
+            static xmlSAXHandler handler = [] {
+                xmlSAXHandler sax;
+                memset(&sax, 0, sizeof(sax));
+                sax.startElement = onStartElement;
+                sax.endElement = onEndElement;
+                sax.characters = onCharacters;
+                return sax;
+            }();
+            context = xmlCreatePushParserCtxt(&handler, this, nullptr, 0, url.c_str());
+            if (context == nullptr) {
+                failed = true;
+                return;
+            }
+            xmlCtxtUseOptions(context, XML_PARSE_NONET | XML_PARSE_NOERROR | XML_PARSE_NOWARNING);
+        }
+        xmlParseChunk(context, xml, (int) length, 0);
+    }
+
+public:
+    std::string url;
+    std::vector<SitemapEntry> urls;
+    std::vector<std::string> sitemaps;
+
+    explicit SitemapParser(std::string url) : url(std::move(url)) {
+        memset(&inflater, 0, sizeof(inflater));
+    }
+
+    SitemapParser(const SitemapParser&) = delete;
+    SitemapParser& operator=(const SitemapParser&) = delete;
+
+    ~SitemapParser() {
+        if (context != nullptr) xmlFreeParserCtxt(context);
+        if (gzipped) inflateEnd(&inflater);
+    }
+
+    // Takes the next downloaded bytes; false once the sitemap is too large or corrupt
+    bool feed(const char* data, size_t length) {
+        if (failed) return false;
+        if (!sniffed && length > 0) {
+            sniffed = true;
+            gzipped = length >= 2 && (unsigned char) data[0] == 0x1F && (unsigned char) data[1] == 0x8B;
+            if (gzipped && inflateInit2(&inflater, 16 + MAX_WBITS) != Z_OK) {
+                gzipped = false;
+                failed = true;
+                return false;
+            }
+        }
+        if (!gzipped) {
+            parse(data, length);
+            return !failed;
+        }
+
+        char out[64 * 1024];
+        inflater.next_in = (Bytef*) data;
+        inflater.avail_in = length;
+        while (inflater.avail_in > 0 && !failed) {
+            inflater.next_out = (Bytef*) out;
+            inflater.avail_out = sizeof(out);
+            int status = inflate(&inflater, Z_NO_FLUSH);
+            if (status != Z_OK && status != Z_STREAM_END && status != Z_BUF_ERROR) {
+                failed = true;
+                break;
+            }
+            size_t produced = sizeof(out) - inflater.avail_out;
+            if (produced > 0) parse(out, produced);
+            if (status == Z_STREAM_END || (status == Z_BUF_ERROR && produced == 0)) break;
+        }
+        return !failed;
+    }
+
+    // Flushes the parser; entries after a parse error are lost but those before it are kept
+    void finish() {
+        if (context != nullptr) xmlParseChunk(context, nullptr, 0, 1);
+    }
+
+    // W3C datetime as sitemaps use it: YYYY, YYYY-MM, YYYY-MM-DD, optionally followed by
+    // Thh:mm[:ss[.s]] and Z or +hh:mm. Returns seconds since the epoch, or 0 if malformed.
+    static double parseW3CDate(std::string_view date) {
+        auto number = [&](size_t at, size_t digits, int& value) {
+            if (date.length() < at + digits) return false;
+            value = 0;
+            for (size_t i = at; i < at + digits; i++) {
+                if (date[i] < '0' || date[i] > '9') return false;
+                value = value * 10 + (date[i] - '0');
+            }
+            return true;
+        };
+
+        struct tm parts;
+        memset(&parts, 0, sizeof(parts));
+        int year, month = 1, day = 1, hour = 0, minute = 0, second = 0;
+        if (!number(0, 4, year)) return 0;
+        size_t at = 4;
+        if (at < date.length() && date[at] == '-' && number(at + 1, 2, month)) at += 3;
+        if (at < date.length() && date[at] == '-' && number(at + 1, 2, day)) at += 3;
+
+        long offset = 0;
+        if (at < date.length() && date[at] == 'T') {
+            if (!number(at + 1, 2, hour) || date.length() < at + 6 || date[at + 3] != ':' || !number(at + 4, 2, minute))
+                return 0;
+            at += 6;
+            if (at < date.length() && date[at] == ':' && number(at + 1, 2, second)) at += 3;
+            while (at < date.length() && (date[at] == '.' || (date[at] >= '0' && date[at] <= '9'))) at++;
+
+            int offsetHours, offsetMinutes;
+            if (at < date.length() && (date[at] == '+' || date[at] == '-') &&
+                number(at + 1, 2, offsetHours) && date.length() >= at + 6 && number(at + 4, 2, offsetMinutes))
+                offset = (date[at] == '+' ? 1 : -1) * (offsetHours * 3600L + offsetMinutes * 60L);
+        }
+
+        parts.tm_year = year - 1900;
+        parts.tm_mon = month - 1;
+        parts.tm_mday = day;
+        parts.tm_hour = hour;
+        parts.tm_min = minute;
+        parts.tm_sec = second;
+        time_t seconds = timegm(&parts);
+        return seconds == (time_t) -1 ? 0 : (double) (seconds - offset);
+    }
+};
+
+#endif
@@ -0,0 +1,59 @@
+// Checks how links resolve and which URL is fetched for pages whose key was shortened.
+// Built and run by `make test`; needs nothing beyond the header.
+#include <iostream>
+#include <string>
+#include "../url_canonicalizer.hpp"
+
+using namespace std;
+
+int failures = 0;
+
+void expect(const string& what, const string& got, const string& wanted)
+{
+    if (got == wanted)
+        return;
+    cout << "FAIL " << what << ": got " << got << ", wanted " << wanted << endl;
+    failures++;
+}
+
+// Key and fetch URL of href found on a page fetched from base
+pair<string, string> link(const string& base, const string& href)
+{
+    UrlCanonicalizer canonicalizer;
+    string key, resolved;
+    if (!canonicalizer.canonicalize(base, href, key, &resolved))
+        return {"(rejected)", "(rejected)"};
+    return {key, resolved};
+}
+
+int main()
+{
+    // A directory page: keyed without its slash, fetched and resolved with it
+    auto [docsKey, docsURL] = link("https://site/", "/docs/");
+    expect("directory key", docsKey, "https://site/docs");
+    expect("directory fetch URL", docsURL, "https://site/docs/");
+    expect("relative link on a page ending in /", link(docsURL, "intro.html").first, "https://site/docs/intro.html");
+    expect("parent link on a page ending in /", link(docsURL, "../about").first, "https://site/about");
+
+    // A default document: keyed as its directory, fetched as linked
+    auto [indexKey, indexURL] = link("https://site/", "docs/index.html");
+    expect("default document key", indexKey, "https://site/docs");
+    expect("default document fetch URL", indexURL, "https://site/docs/index.html");
+    expect("relative link on a page ending in index.html", link(indexURL, "intro.html").first, "https://site/docs/intro.html");
+
+    // Both forms of the same page share a key
+    expect("same key", docsKey, indexKey);
+
+    // The fetch URL is normalized like the key, apart from the slash and default document
+    auto [queryKey, queryURL] = link("https://site/", "HTTPS://Site:443/a/./b/?utm_source=x&b=2&a=1#top");
+    expect("query key", queryKey, "https://site/a/b?a=1&b=2");
+    expect("query fetch URL", queryURL, "https://site/a/b/?a=1&b=2");
+
+    // Links without anything dropped are fetched as keyed
+    auto [pageKey, pageURL] = link("https://site/docs/", "intro.html");
+    expect("plain page fetch URL", pageURL, pageKey);
+
+    if (failures == 0)
+        cout << "url_canonicalizer_test: all passed" << endl;
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,315 @@
+#ifndef _URL_CANONICALIZER_H_
+#define _URL_CANONICALIZER_H_
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <algorithm>
+#include <cstring>
+
+// Which query parameters are dropped and whether the rest are sorted. A name ending in
+// '*' matches every parameter with that prefix; names compare case-insensitively.
+struct CanonicalizerOptions {
+    std::vector<std::string> strippedParameters = {
+        "utm_*", "gclid", "fbclid", "msclkid", "mc_cid", "mc_eid", "_ga",
+        "sessionid", "session_id", "sid", "jsessionid", "phpsessid", "aspsessionid"
+    };
+    std::vector<std::string> defaultDocuments = {
+        "index.html", "index.htm", "index.php", "default.htm", "default.html", "default.aspx"
+    };
+    bool sortParameters = true;
+};
+
+// Resolves a link against the page it was found on and normalizes the result (RFC 3986
+// section 6: lowercase scheme and host, default port removed, percent-encoding case
+// fixed and unreserved characters decoded, dot segments removed, fragment dropped) plus
+// a few crawler rules: default documents and tracking parameters are removed, parameters
+// are sorted, and a trailing slash is dropped. Everything is written into buffers the
+// canonicalizer keeps, so after warm-up a link costs no allocations. One per thread.
+class UrlCanonicalizer {
+private:
+    struct Parts {
+        std::string_view scheme, authority, path, query;
+        bool hasScheme = false, hasAuthority = false, hasQuery = false;
+    };
+
+    CanonicalizerOptions options;
+    std::string path;                         // scratch for the percent-normalized path
+    std::vector<std::string_view> parameters; // scratch for query parameters
+    bool changed = false;                     // normalization altered the current link
+
+    static bool isAlpha(char c) {
+        return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+    }
+
+    static bool isUnreserved(unsigned char c) {
+        return isAlpha(c) || (c >= '0' && c <= '9') || c == '-' || c == '.' || c == '_' || c == '~';
+    }
+
+    static int hexValue(char c) {
+        if (c >= '0' && c <= '9') return c - '0';
+        if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+        return -1;
+    }
+
+    static char lower(char c) {
+        return c >= 'A' && c <= 'Z' ? c + 32 : c;
+    }
+
+    // RFC 3986 appendix B, without the fragment
+    static Parts split(std::string_view url) {
+        Parts parts;
+        size_t fragment = url.find('#');
+        if (fragment != std::string_view::npos) url = url.substr(0, fragment);
+
+        size_t colon = url.find_first_of(":/?");
+        if (colon != std::string_view::npos && url[colon] == ':' && colon > 0 && isAlpha(url[0])) {
+            parts.scheme = url.substr(0, colon);
+            parts.hasScheme = true;
+            url.remove_prefix(colon + 1);
+        }
+        if (url.substr(0, 2) == "//") {
+            url.remove_prefix(2);
+            size_t end = url.find_first_of("/?");
+            parts.authority = url.substr(0, end);
+            parts.hasAuthority = true;
+            url.remove_prefix(end == std::string_view::npos ? url.length() : end);
+        }
+        size_t question = url.find('?');
+        parts.path = url.substr(0, question);
+        if (question != std::string_view::npos) {
+            parts.query = url.substr(question + 1);
+            parts.hasQuery = true;
+        }
+        return parts;
+    }
+
+    static bool equalsIgnoreCase(std::string_view a, std::string_view b) {
+        if (a.length() != b.length()) return false;
+        for (size_t i = 0; i < a.length(); ++i)
+            if (lower(a[i]) != lower(b[i])) return false;
+        return true;
+    }
+
+    bool isStripped(std::string_view parameter) const {
+        std::string_view name = parameter.substr(0, parameter.find('='));
+        for (const auto& pattern : options.strippedParameters) {
+            if (!pattern.empty() && pattern.back() == '*') {
+                std::string_view prefix(pattern.data(), pattern.length() - 1);
+                if (name.length() >= prefix.length() && equalsIgnoreCase(name.substr(0, prefix.length()), prefix))
+                    return true;
+            } else if (equalsIgnoreCase(name, pattern)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Copies s into path, uppercasing percent-escapes and decoding unreserved ones
+    void appendPercentNormalized(std::string_view s) {
+        for (size_t i = 0; i < s.length(); ++i) {
+            static const char digits[] = "0123456789ABCDEF";
+            if (s[i] == '%' && i + 2 < s.length() && hexValue(s[i + 1]) >= 0 && hexValue(s[i + 2]) >= 0) {
+                unsigned char decoded = hexValue(s[i + 1]) * 16 + hexValue(s[i + 2]);
+                if (isUnreserved(decoded)) {
+                    path += (char) decoded;
+                    changed = true;
+                } else {
+                    path += '%';
+                    path += digits[decoded >> 4];
+                    path += digits[decoded & 15];
+                    changed |= s[i + 1] != digits[decoded >> 4] || s[i + 2] != digits[decoded & 15];
+                }
+                i += 2;
+            } else if ((unsigned char) s[i] <= ' ' || s[i] == '"' || s[i] == '<' || s[i] == '>' || (unsigned char) s[i] >= 0x7F) {
+                path += '%';
+                path += digits[(unsigned char) s[i] >> 4];
+                path += digits[(unsigned char) s[i] & 15];
+                changed = true;
+            } else {
+                path += s[i];
+            }
+        }
+    }
+
+    // Appends path to out with "." and ".." segments removed (RFC 3986 5.2.4)
+    void appendWithoutDotSegments(std::string_view in, std::string& out) {
+        size_t root = out.length();
+        while (!in.empty()) {
+            size_t end = in.find('/', 1);
+            std::string_view segment = in.substr(0, end);
+            in.remove_prefix(end == std::string_view::npos ? in.length() : end);
+            bool last = in.empty();
+
+            if (segment == "/." || segment == "/..") {
+                changed = true;
+                if (segment == "/..") {
+                    size_t slash = out.rfind('/');
+                    out.resize(slash == std::string::npos || slash < root ? root : slash);
+                }
+                if (last) out += '/';
+            } else if (segment != "." && segment != "..") {
+                out += segment;
+            }
+        }
+        if (out.length() == root) out += '/';
+    }
+
+public:
+    UrlCanonicalizer() = default;
+    explicit UrlCanonicalizer(CanonicalizerOptions options) : options(std::move(options)) {}
+
+    // Writes the canonical form of href, relative to base, into out and returns true, or
+    // returns false for links that are not http(s) or only point within the same page.
+    // The canonical form is a key: it names the page, but with its trailing slash and
+    // default document gone it is not always the URL to fetch or to resolve the page's own
+    // links against. If `resolved` is given, it receives that URL: normalized the same
+    // way, with the trailing slash and default document kept.
+    bool canonicalize(std::string_view base, std::string_view href, std::string& out, std::string* resolved = nullptr) {
+        while (!href.empty() && (unsigned char) href.front() <= ' ') href.remove_prefix(1);
+        while (!href.empty() && (unsigned char) href.back() <= ' ') href.remove_suffix(1);
+        if (href.empty() || href.front() == '#') return false;
+
+        Parts ref = split(href);
+        Parts from = split(base);
+        changed = href.find('#') != std::string_view::npos;
+
+        // Resolution (RFC 3986 5.2.2)
+        Parts target;
+        path.clear();
+        if (ref.hasScheme) {
+            target = ref;
+            appendPercentNormalized(ref.path);
+        } else {
+            target.scheme = from.scheme;
+            target.hasScheme = from.hasScheme;
+            if (ref.hasAuthority) {
+                target.authority = ref.authority;
+                target.hasAuthority = true;
+                appendPercentNormalized(ref.path);
+                target.query = ref.query;
+                target.hasQuery = ref.hasQuery;
+            } else {
+                target.authority = from.authority;
+                target.hasAuthority = from.hasAuthority;
+                if (ref.path.empty()) {
+                    appendPercentNormalized(from.path);
+                    target.query = ref.hasQuery ? ref.query : from.query;
+                    target.hasQuery = ref.hasQuery || from.hasQuery;
+                } else {
+                    if (ref.path.front() != '/') {
+                        // merge: everything up to the last '/' of the base path
+                        size_t slash = from.path.rfind('/');
+                        if (slash != std::string_view::npos)
+                            appendPercentNormalized(from.path.substr(0, slash + 1));
+                        else
+                            path += '/';
+                    }
+                    appendPercentNormalized(ref.path);
+                    target.query = ref.query;
+                    target.hasQuery = ref.hasQuery;
+                }
+            }
+        }
+
+        if (!equalsIgnoreCase(target.scheme, "http") && !equalsIgnoreCase(target.scheme, "https"))
+            return false;
+        bool https = target.scheme.length() == 5;
+
+        // Scheme and host
+        out.clear();
+        out += https ? "https://" : "http://";
+        changed |= target.scheme != (https ? "https" : "http");
+
+        std::string_view authority = target.authority;
+        size_t at = authority.rfind('@');
+        if (at != std::string_view::npos) {
+            authority.remove_prefix(at + 1); // credentials are never crawled with
+            changed = true;
+        }
+        size_t colon = authority.rfind(':');
+        if (colon != std::string_view::npos && authority.find(']', colon) != std::string_view::npos)
+            colon = std::string_view::npos; // the colon belongs to an IPv6 literal
+        std::string_view host = authority.substr(0, colon);
+        std::string_view port = colon == std::string_view::npos ? std::string_view() : authority.substr(colon + 1);
+        if (!host.empty() && host.back() == '.') {
+            host.remove_suffix(1);
+            changed = true;
+        }
+        if (host.empty()) return false;
+
+        for (char c : host)
+            out += lower(c);
+        while (port.length() > 1 && port.front() == '0') port.remove_prefix(1);
+        if (colon != std::string_view::npos) {
+            if (port.empty() || port == (https ? "443" : "80")) {
+                changed = true;
+            } else {
+                out += ':';
+                out += port;
+            }
+        }
+
+        // Path
+        // Dot segments in a relative link are part of resolving it, not a rewrite
+        bool relative = !ref.hasScheme && !ref.hasAuthority && !ref.path.empty() && ref.path.front() != '/';
+        bool changedBefore = changed;
+        if (path.empty()) path += '/';
+        appendWithoutDotSegments(path, out);
+        if (relative) changed = changedBefore;
+        if (resolved != nullptr) resolved->assign(out);
+        size_t lastSlash = out.rfind('/');
+        std::string_view document(out.data() + lastSlash + 1, out.length() - lastSlash - 1);
+        for (const auto& name : options.defaultDocuments) {
+            if (equalsIgnoreCase(document, name)) {
+                out.resize(lastSlash + 1);
+                changed = true;
+                break;
+            }
+        }
+
+        // Query: tracking parameters dropped, the rest sorted
+        parameters.clear();
+        std::string_view query = target.hasQuery ? target.query : std::string_view();
+        while (!query.empty()) {
+            size_t amp = query.find('&');
+            std::string_view parameter = query.substr(0, amp);
+            query.remove_prefix(amp == std::string_view::npos ? query.length() : amp + 1);
+            if (parameter.empty() || isStripped(parameter)) {
+                changed = true;
+                continue;
+            }
+            parameters.push_back(parameter);
+        }
+        if (options.sortParameters && !std::is_sorted(parameters.begin(), parameters.end())) {
+            std::sort(parameters.begin(), parameters.end());
+            changed = true;
+        }
+        if (target.hasQuery && parameters.empty() && !target.query.empty())
+            changed = true;
+
+        // The crawler has always stored URLs without a trailing slash
+        if (out.back() == '/')
+            out.pop_back();
+
+        for (size_t i = 0; i < parameters.size(); ++i) {
+            out += i == 0 ? '?' : '&';
+            out += parameters[i];
+            if (resolved != nullptr) {
+                *resolved += i == 0 ? '?' : '&';
+                *resolved += parameters[i];
+            }
+        }
+        return true;
+    }
+
+    // Whether the last canonicalized link was rewritten beyond resolving it, lowercasing
+    // its host and dropping its trailing slash (which is all links used to get), so a
+    // visited hit on it is a fetch the old normalization would have repeated
+    bool lastChanged() const {
+        return changed;
+    }
+};
+
+#endif
@@ -0,0 +1,246 @@
+#ifndef _WARC_H_
+#define _WARC_H_
+
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <random>
+#include <string>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <functional>
+#include <string_view>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <zstd.h>
+
+//zstd level each record is compressed at; 3 is zstd's default and keeps up with the crawl
+#define WARC_ZSTD_LEVEL 3
+
+// One record of a WARC file: its named header fields and its content block
+struct WarcRecord {
+    std::string_view type;      // WARC-Type
+    std::string_view targetURI; // WARC-Target-URI
+    std::string_view date;      // WARC-Date
+    std::string_view block;     // for a response, the HTTP status line, headers and body
+
+    // WARC-Date in seconds since the epoch, 0 if it can't be read
+    double time() const {
+        struct tm parts;
+        memset(&parts, 0, sizeof(parts));
+        std::string text(date);
+        if (strptime(text.c_str(), "%Y-%m-%dT%H:%M:%S", &parts) == nullptr) return 0;
+        return (double) timegm(&parts);
+    }
+};
+
+// Writes WARC 1.1 files (ISO 28500) in which every record is its own zstd frame, so the
+// archive is a valid .warc.zst stream and any record can be decompressed without the ones
+// before it. Workers compress outside the lock; only the write is serialized.
+class WarcWriter {
+private:
+    FILE* file = nullptr;
+    std::mutex fileMutex;
+
+    static std::string recordId() {
+        static thread_local std::mt19937_64 random(std::random_device{}() ^ std::hash<std::thread::id>()(std::this_thread::get_id()));
+        uint64_t high = random(), low = random();
+        high = (high & ~0xF000ULL) | 0x4000ULL;                  // version 4
+        low = (low & ~(3ULL << 62)) | (2ULL << 62);              // RFC 4122 variant
+        char id[64];
+        snprintf(id, sizeof(id), "<urn:uuid:%08x-%04x-%04x-%04x-%012llx>",
+                 (unsigned) (high >> 32), (unsigned) ((high >> 16) & 0xFFFF), (unsigned) (high & 0xFFFF),
+                 (unsigned) (low >> 48), (unsigned long long) (low & 0xFFFFFFFFFFFFULL));
+        return id;
+    }
+
+    static std::string date(double seconds) {
+        time_t whole = (time_t) seconds;
+        struct tm parts;
+        gmtime_r(&whole, &parts);
+        char text[32];
+        strftime(text, sizeof(text), "%Y-%m-%dT%H:%M:%SZ", &parts);
+        return text;
+    }
+
+    void write(std::string_view type, std::string_view targetURI, double seconds, std::string_view contentType,
+               std::string_view head, std::string_view body) {
+        static thread_local std::string record;
+        static thread_local std::string compressed;
+        static thread_local std::unique_ptr<ZSTD_CCtx, size_t (*)(ZSTD_CCtx*)> context(ZSTD_createCCtx(), ZSTD_freeCCtx);
+
+        record.clear();
+        record += "WARC/1.1\r\nWARC-Type: ";
+        record += type;
+        record += "\r\n";
+        if (!targetURI.empty()) {
+            record += "WARC-Target-URI: ";
+            record += targetURI;
+            record += "\r\n";
+        }
+        record += "WARC-Date: " + date(seconds) + "\r\n";
+        record += "WARC-Record-ID: " + recordId() + "\r\n";
+        record += "Content-Type: ";
+        record += contentType;
+        record += "\r\nContent-Length: " + std::to_string(head.size() + body.size()) + "\r\n\r\n";
+        record += head;
+        record += body;
+        record += "\r\n\r\n";
+
+        compressed.resize(ZSTD_compressBound(record.size()));
+        size_t size = ZSTD_compressCCtx(context.get(), &compressed[0], compressed.size(), record.data(), record.size(), WARC_ZSTD_LEVEL);
+        if (ZSTD_isError(size)) return;
+
+        std::lock_guard<std::mutex> guard(fileMutex);
+        if (file == nullptr) return;
+        fwrite(compressed.data(), 1, size, file);
+        records.fetch_add(1, std::memory_order_relaxed);
+        rawBytes.fetch_add(record.size(), std::memory_order_relaxed);
+        compressedBytes.fetch_add(size, std::memory_order_relaxed);
+    }
+
+public:
+    std::atomic<uint64_t> records{0};
+    std::atomic<uint64_t> rawBytes{0};
+    std::atomic<uint64_t> compressedBytes{0};
+
+    WarcWriter() = default;
+    WarcWriter(const WarcWriter&) = delete;
+    WarcWriter& operator=(const WarcWriter&) = delete;
+
+    ~WarcWriter() {
+        close();
+    }
+
+    // Appends to the archive at path, starting it with a warcinfo record if it is new
+    bool open(const char* path, double seconds) {
+        file = fopen(path, "ab");
+        if (file == nullptr) return false;
+        fseek(file, 0, SEEK_END);
+        if (ftell(file) == 0) {
+            std::string filename(path);
+            filename = filename.substr(filename.rfind('/') + 1);
+            write("warcinfo", "", seconds, "application/warc-fields", "",
+                  "software: search-engine crawler\r\nformat: WARC File Format 1.1\r\nfilename: " + filename + "\r\n");
+        }
+        return true;
+    }
+
+    bool isOpen() const {
+        return file != nullptr;
+    }
+
+    // headers is the response's status line and header lines, each ending in CRLF, without
+    // the blank line; body is the decoded payload that follows it
+    void writeResponse(std::string_view url, double seconds, std::string_view headers, std::string_view body) {
+        std::string head(headers);
+        head += "Content-Length: " + std::to_string(body.size()) + "\r\n\r\n";
+        write("response", url, seconds, "application/http;msgtype=response", head, body);
+    }
+
+    void close() {
+        std::lock_guard<std::mutex> guard(fileMutex);
+        if (file == nullptr) return;
+        fclose(file);
+        file = nullptr;
+    }
+};
+
+// Reads a .warc.zst archive on many threads at once. The file is mapped and split at its
+// zstd frame boundaries, which only needs the frame headers; workers then take frames in
+// turn, decompress them and call fn(record) for every record inside. Returns false if the
+// file can't be read or isn't zstd.
+inline bool forEachWarcRecord(const char* path, size_t workers, const std::function<void(const WarcRecord&)>& fn) {
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0) return false;
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size == 0) {
+        ::close(fd);
+        return false;
+    }
+    size_t length = info.st_size;
+    const char* data = (const char*) mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED) return false;
+    madvise((void*) data, length, MADV_SEQUENTIAL);
+
+    std::vector<std::pair<size_t, size_t>> frames; // offset, compressed size
+    for (size_t offset = 0; offset < length;) {
+        size_t size = ZSTD_findFrameCompressedSize(data + offset, length - offset);
+        if (ZSTD_isError(size)) break; // a torn frame at the end of an interrupted crawl
+        frames.emplace_back(offset, size);
+        offset += size;
+    }
+    if (frames.empty()) {
+        munmap((void*) data, length);
+        return false;
+    }
+
+    std::atomic<size_t> next{0};
+    auto work = [&] {
+        ZSTD_DCtx* context = ZSTD_createDCtx();
+        std::string plain;
+        for (size_t i; (i = next.fetch_add(1)) < frames.size();) {
+            const char* frame = data + frames[i].first;
+            unsigned long long size = ZSTD_getFrameContentSize(frame, frames[i].second);
+            if (size == ZSTD_CONTENTSIZE_ERROR || size == ZSTD_CONTENTSIZE_UNKNOWN) continue;
+            plain.resize(size);
+            size_t got = ZSTD_decompressDCtx(context, &plain[0], plain.size(), frame, frames[i].second);
+            if (ZSTD_isError(got)) continue;
+
+            // A frame normally holds one record, but concatenated records are read in turn
+            std::string_view rest(plain.data(), got);
+            while (rest.substr(0, 5) == "WARC/") {
+                size_t headerEnd = rest.find("\r\n\r\n");
+                if (headerEnd == std::string_view::npos) break;
+
+                WarcRecord record;
+                size_t contentLength = std::string_view::npos;
+                std::string_view headers = rest.substr(0, headerEnd);
+                while (!headers.empty()) {
+                    size_t eol = headers.find("\r\n");
+                    std::string_view line = headers.substr(0, eol);
+                    headers.remove_prefix(eol == std::string_view::npos ? headers.size() : eol + 2);
+
+                    size_t colon = line.find(':');
+                    if (colon == std::string_view::npos) continue;
+                    std::string_view name = line.substr(0, colon);
+                    std::string_view value = line.substr(colon + 1);
+                    while (!value.empty() && value.front() == ' ') value.remove_prefix(1);
+                    if (name == "WARC-Type") record.type = value;
+                    else if (name == "WARC-Target-URI") record.targetURI = value;
+                    else if (name == "WARC-Date") record.date = value;
+                    else if (name == "Content-Length") contentLength = strtoull(std::string(value).c_str(), nullptr, 10);
+                }
+
+                rest.remove_prefix(headerEnd + 4);
+                if (contentLength > rest.size()) break;
+                record.block = rest.substr(0, contentLength);
+                fn(record);
+                rest.remove_prefix(contentLength);
+                while (!rest.empty() && (rest.front() == '\r' || rest.front() == '\n')) rest.remove_prefix(1);
+            }
+        }
+        ZSTD_freeDCtx(context);
+    };
+
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < std::max<size_t>(workers, 1); i++)
+        threads.emplace_back(work);
+    work();
+    for (auto& thread : threads)
+        thread.join();
+
+    munmap((void*) data, length);
+    return true;
+}
+
+#endif
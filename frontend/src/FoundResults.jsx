@@ -6,6 +6,7 @@ const BaseUrl = "http://localhost:1337/";
 function FoundResults({ query }) {
   const [results, setResults] = useState([]);
   const [loading, setLoading] = useState(false);
+  const [correctedQuery, setCorrectedQuery] = useState(null);
 
   useEffect(() => {
     const fetchResults = async () => {
@@ -26,9 +27,12 @@ function FoundResults({ query }) {
 
         const data = await response.json();
         setResults(data || []);
+        // Set when misspelled words were searched as their closest indexed terms
+        setCorrectedQuery(response.headers.get("X-Corrected-Query"));
       } catch (error) {
         console.error("Error fetching data:", error);
         setResults([]);
+        setCorrectedQuery(null);
       } finally {
         setLoading(false);
       }
@@ -49,6 +53,12 @@ function FoundResults({ query }) {
             Found <span className="font-extrabold">{results.length}</span> results for
             <span className="font-extrabold"> &quot;{query}&quot;</span>
           </p>
+          {correctedQuery && (
+            <p className="text-lg">
+              Showing results for
+              <span className="italic"> {correctedQuery}</span>
+            </p>
+          )}
           <ul>
             {results.map((result, index) => (
               <div
@@ -1,7 +1,7 @@
 import React from "react";
 import { useState, useEffect } from "react";
 import { useNavigate } from "react-router-dom";
-import { useSearch } from "./useSearch";
+import { useSearch, useSuggestions } from "./useSearch";
 
 function Search({ query, setQuery }) {
   // const [imageLoaded, setImageLoaded] = useState(false);
@@ -13,11 +13,17 @@ function Search({ query, setQuery }) {
   // }, []);
 
   const navigate = useNavigate();
+  const suggestions = useSuggestions(query);
 
   const handleSearch = (event) => {
     event.preventDefault();
     navigate(`/results?query=${query}`);
   };
+
+  const handleSuggestion = (suggestion) => {
+    setQuery(suggestion.query);
+    navigate(`/results?query=${suggestion.query}`);
+  };
   return (
     <div className="text-center">
       <form className="mx-auto max-w-md">
@@ -60,6 +66,19 @@ function Search({ query, setQuery }) {
           >
             Search
           </button>
+          {suggestions.length > 0 && (
+            <ul className="absolute z-10 mt-1 w-full rounded-lg border border-gray-300 bg-white py-1 text-left">
+              {suggestions.map((suggestion) => (
+                <li
+                  key={suggestion.term}
+                  onMouseDown={() => handleSuggestion(suggestion)}
+                  className="cursor-pointer px-10 py-1 hover:bg-gray-100"
+                >
+                  {suggestion.query}
+                </li>
+              ))}
+            </ul>
+          )}
         </div>
       </form>
     </div>
@@ -1,6 +1,45 @@
-import { useState } from "react";
+import { useEffect, useState } from "react";
+
+const BaseUrl = "http://localhost:1337/";
 
 export const useSearch = () => {
   const [query, setQuery] = useState("");
   return { query, setQuery };
 };
+
+// Completions for the word being typed, fetched once typing pauses
+export const useSuggestions = (query) => {
+  const [suggestions, setSuggestions] = useState([]);
+
+  useEffect(() => {
+    if (!/[a-z]$/i.test(query)) {
+      setSuggestions([]);
+      return;
+    }
+
+    const controller = new AbortController();
+    const timer = setTimeout(async () => {
+      try {
+        const response = await fetch(
+          `${BaseUrl}suggest?q=${encodeURIComponent(query)}&k=8`,
+          { signal: controller.signal },
+        );
+
+        if (!response.ok) {
+          throw new Error(`Error: ${response.status}`);
+        }
+
+        setSuggestions(await response.json());
+      } catch (error) {
+        if (error.name !== "AbortError") setSuggestions([]);
+      }
+    }, 100);
+
+    return () => {
+      clearTimeout(timer);
+      controller.abort();
+    };
+  }, [query]);
+
+  return suggestions;
+};
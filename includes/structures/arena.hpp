@@ -0,0 +1,98 @@
+#ifndef _ARENA_H_
+#define _ARENA_H_
+
+#include <atomic>
+#include <memory>
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+
+//bytes each thread's arena can hand out before it has to ask the heap for more
+#define ARENA_INITIAL_BYTES (256 * 1024)
+
+// Forwards to another resource and counts the allocations that reach it
+class CountingResource : public std::pmr::memory_resource {
+private:
+    std::pmr::memory_resource *upstream;
+
+    void *do_allocate(size_t bytes, size_t alignment) override {
+        allocations.fetch_add(1, std::memory_order_relaxed);
+        allocatedBytes.fetch_add(bytes, std::memory_order_relaxed);
+        return upstream->allocate(bytes, alignment);
+    }
+
+    void do_deallocate(void *p, size_t bytes, size_t alignment) override {
+        upstream->deallocate(p, bytes, alignment);
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override {
+        return this == &other;
+    }
+
+public:
+    std::atomic<uint64_t> allocations{0};
+    std::atomic<uint64_t> allocatedBytes{0};
+
+    explicit CountingResource(std::pmr::memory_resource *upstream = std::pmr::new_delete_resource())
+        : upstream(upstream) {}
+};
+
+// Monotonic per-thread arena for state that only lives as long as one request.
+// Allocating is a pointer bump, deallocating is a no-op, and reset() hands the
+// whole arena back at once. Only requests that outgrow the initial block touch the heap.
+class RequestArena {
+private:
+    std::unique_ptr<char[]> initialBlock;
+    std::pmr::monotonic_buffer_resource resource;
+
+    RequestArena()
+        : initialBlock(new char[ARENA_INITIAL_BYTES]),
+          resource(initialBlock.get(), ARENA_INITIAL_BYTES, &overflow()) {}
+
+public:
+    RequestArena(const RequestArena &) = delete;
+    RequestArena &operator=(const RequestArena &) = delete;
+
+    // Heap allocations made by all arenas after their initial block ran out
+    static CountingResource &overflow() {
+        static CountingResource counter;
+        return counter;
+    }
+
+    static std::atomic<uint64_t> &resets() {
+        static std::atomic<uint64_t> count{0};
+        return count;
+    }
+
+    static RequestArena &local() {
+        static thread_local RequestArena arena;
+        return arena;
+    }
+
+    std::pmr::memory_resource *get() {
+        return &resource;
+    }
+
+    void reset() {
+        resource.release();
+        resets().fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Resets the calling thread's arena when it goes out of scope. Everything
+    // allocated from it must be destroyed first.
+    class Scope {
+    private:
+        RequestArena &arena;
+
+    public:
+        Scope() : arena(RequestArena::local()) {}
+        ~Scope() { arena.reset(); }
+
+        Scope(const Scope &) = delete;
+        Scope &operator=(const Scope &) = delete;
+
+        std::pmr::memory_resource *resource() { return arena.get(); }
+    };
+};
+
+#endif
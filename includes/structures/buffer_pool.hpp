@@ -0,0 +1,98 @@
+#ifndef _BUFFER_POOL_H_
+#define _BUFFER_POOL_H_
+
+#include <mutex>
+#include <vector>
+#include <cstdlib>
+#include <cstring>
+#include <cstddef>
+
+//starting capacity of a fresh buffer
+#define BUFFER_INITIAL_BYTES (64 * 1024)
+//buffers that grew past this are shrunk back when returned to the pool
+#define BUFFER_RETAIN_BYTES (4 * 1024 * 1024)
+
+// Growable byte buffer that keeps its storage between uses. The contents are always
+// NUL terminated so they can be handed to C string functions as well as (data, size) APIs.
+struct Buffer {
+    char* data = nullptr;
+    size_t size = 0;
+    size_t capacity = 0;
+
+    Buffer() = default;
+    Buffer(const Buffer&) = delete;
+    Buffer& operator=(const Buffer&) = delete;
+
+    ~Buffer() {
+        free(data);
+    }
+
+    // Makes room for `extra` more bytes plus the terminator, doubling the capacity
+    bool reserve(size_t extra) {
+        size_t needed = size + extra + 1;
+        if (needed <= capacity) return true;
+
+        size_t newCapacity = capacity ? capacity : BUFFER_INITIAL_BYTES;
+        while (newCapacity < needed) newCapacity *= 2;
+
+        char* grown = (char*) realloc(data, newCapacity);
+        if (grown == nullptr) return false;
+        data = grown;
+        capacity = newCapacity;
+        return true;
+    }
+
+    bool append(const void* bytes, size_t length) {
+        if (!reserve(length)) return false;
+        memcpy(data + size, bytes, length);
+        size += length;
+        data[size] = 0;
+        return true;
+    }
+
+    void clear() {
+        size = 0;
+        if (data) data[0] = 0;
+    }
+};
+
+// Hands out buffers to crawler workers and takes them back, so steady-state crawling
+// does not allocate per page
+class BufferPool {
+private:
+    std::mutex poolMutex;
+    std::vector<Buffer*> available;
+
+public:
+    BufferPool() = default;
+    BufferPool(const BufferPool&) = delete;
+    BufferPool& operator=(const BufferPool&) = delete;
+
+    ~BufferPool() {
+        for (Buffer* buffer : available) delete buffer;
+    }
+
+    Buffer* acquire() {
+        std::lock_guard<std::mutex> guard(poolMutex);
+        if (available.empty()) return new Buffer();
+
+        Buffer* buffer = available.back();
+        available.pop_back();
+        return buffer;
+    }
+
+    void release(Buffer* buffer) {
+        buffer->clear();
+        // Don't let one huge page pin its memory for the rest of the crawl
+        if (buffer->capacity > BUFFER_RETAIN_BYTES) {
+            free(buffer->data);
+            buffer->data = nullptr;
+            buffer->capacity = 0;
+        }
+
+        std::lock_guard<std::mutex> guard(poolMutex);
+        available.push_back(buffer);
+    }
+};
+
+#endif
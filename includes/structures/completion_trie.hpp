@@ -0,0 +1,268 @@
+#ifndef _COMPLETION_TRIE_H_
+#define _COMPLETION_TRIE_H_
+
+#include <queue>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+#include <algorithm>
+#include <string_view>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+//first bytes of a completion trie file, including the format version
+#define COMPLETION_TRIE_MAGIC "COMPTRI1"
+
+// A node of the trie as stored. Edges are path compressed, so a node's label is the whole
+// run of bytes leading to it from its parent. Children sit next to each other, best subtree
+// first.
+struct CompletionNode {
+    uint32_t labelOffset;
+    uint32_t labelLength;
+    uint32_t firstChild;
+    uint32_t childCount;
+    float weight;   // of the term ending here, or -1 if none does
+    float maxScore; // best weight in the subtree
+};
+
+struct CompletionTrieHeader {
+    char magic[8];
+    uint64_t nodes;
+    uint64_t labelBytes;
+};
+
+// Collects weighted terms in increasing byte order and writes them as a completion trie
+class CompletionTrieBuilder {
+private:
+    std::vector<std::pair<std::string, float>> terms;
+    std::vector<CompletionNode> nodes;
+    std::string labels;
+
+    // Fills in nodes[index] for terms[begin, end), which all share their first `depth` bytes
+    void build(uint32_t index, size_t begin, size_t end, size_t depth) {
+        // The label runs as far as every term in the range agrees
+        const std::string& first = terms[begin].first;
+        const std::string& last = terms[end - 1].first;
+        size_t common = depth;
+        while (common < first.size() && common < last.size() && first[common] == last[common]) common++;
+
+        CompletionNode node;
+        node.labelOffset = labels.size();
+        node.labelLength = common - depth;
+        labels.append(first, depth, common - depth);
+        node.weight = -1;
+        if (first.size() == common) node.weight = terms[begin++].second;
+
+        // Children are the runs of terms with the same next byte
+        std::vector<std::pair<size_t, size_t>> groups;
+        for (size_t i = begin; i < end;) {
+            size_t j = i + 1;
+            while (j < end && terms[j].first[common] == terms[i].first[common]) j++;
+            groups.emplace_back(i, j);
+            i = j;
+        }
+
+        node.firstChild = nodes.size();
+        node.childCount = groups.size();
+        nodes.resize(nodes.size() + groups.size());
+        for (size_t i = 0; i < groups.size(); i++)
+            build(node.firstChild + i, groups[i].first, groups[i].second, common);
+
+        auto children = nodes.begin() + node.firstChild;
+        std::stable_sort(children, children + node.childCount, [](const CompletionNode& a, const CompletionNode& b) {
+            return a.maxScore > b.maxScore;
+        });
+        node.maxScore = std::max(node.weight, node.childCount > 0 ? children->maxScore : -1.0f);
+        nodes[index] = node;
+    }
+
+public:
+    // False, and the term is ignored, unless it sorts after every term added before it
+    bool add(std::string_view term, float weight) {
+        if (!terms.empty() && term <= std::string_view(terms.back().first)) return false;
+        terms.emplace_back(std::string(term), weight);
+        return true;
+    }
+
+    size_t size() const {
+        return terms.size();
+    }
+
+    // Written to a temporary file that is renamed over path, so a reader never maps half a file
+    bool write(const std::string& path) {
+        nodes.assign(1, CompletionNode());
+        labels.clear();
+        if (terms.empty())
+            nodes[0] = CompletionNode{0, 0, 1, 0, -1, -1};
+        else
+            build(0, 0, terms.size(), 0);
+
+        std::string temporary = path + ".tmp";
+        FILE* out = fopen(temporary.c_str(), "wb");
+        if (out == nullptr) return false;
+
+        CompletionTrieHeader header;
+        memcpy(header.magic, COMPLETION_TRIE_MAGIC, sizeof(header.magic));
+        header.nodes = nodes.size();
+        header.labelBytes = labels.size();
+
+        bool ok = fwrite(&header, sizeof(header), 1, out) == 1;
+        ok &= fwrite(nodes.data(), sizeof(CompletionNode), nodes.size(), out) == nodes.size();
+        ok &= fwrite(labels.data(), 1, labels.size(), out) == labels.size();
+        ok &= fclose(out) == 0;
+        if (!ok || rename(temporary.c_str(), path.c_str()) != 0) {
+            remove(temporary.c_str());
+            return false;
+        }
+        return true;
+    }
+};
+
+// Top-k completions of a prefix from a mapped, path compressed trie (Hsu and Ottaviano,
+// "Space-Efficient Data Structures for Top-k Completion"). Every node carries the best
+// weight below it, so the search walks down to the prefix and then expands nodes best
+// first: a term comes out of the queue only once nothing left in it can beat it, and the
+// work grows with k and the fan-out, not with the number of terms under the prefix.
+class CompletionTrie {
+private:
+    const char* mapping = nullptr;
+    size_t length = 0;
+    const CompletionTrieHeader* header = nullptr;
+    const CompletionNode* nodes = nullptr;
+    const char* labels = nullptr;
+
+    std::string_view label(const CompletionNode& node) const {
+        return std::string_view(labels + node.labelOffset, node.labelLength);
+    }
+
+public:
+    CompletionTrie() = default;
+    CompletionTrie(const CompletionTrie&) = delete;
+    CompletionTrie& operator=(const CompletionTrie&) = delete;
+
+    ~CompletionTrie() {
+        close();
+    }
+
+    // Maps the trie at path; false if it can't be read or isn't a completion trie
+    bool open(const std::string& path) {
+        close();
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        struct stat info;
+        if (fstat(fd, &info) != 0 || (size_t) info.st_size < sizeof(CompletionTrieHeader)) {
+            ::close(fd);
+            return false;
+        }
+        length = info.st_size;
+        void* mapped = mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (mapped == MAP_FAILED) {
+            length = 0;
+            return false;
+        }
+        mapping = (const char*) mapped;
+
+        header = (const CompletionTrieHeader*) mapping;
+        nodes = (const CompletionNode*) (mapping + sizeof(CompletionTrieHeader));
+        labels = (const char*) (nodes + header->nodes);
+        bool valid = memcmp(header->magic, COMPLETION_TRIE_MAGIC, sizeof(header->magic)) == 0 && header->nodes > 0 &&
+                     sizeof(CompletionTrieHeader) + header->nodes * sizeof(CompletionNode) + header->labelBytes == length;
+        if (!valid) close();
+        return valid;
+    }
+
+    void close() {
+        if (mapping != nullptr) munmap((void*) mapping, length);
+        mapping = nullptr;
+        length = 0;
+        header = nullptr;
+    }
+
+    // Bytes mapped
+    size_t bytes() const {
+        return length;
+    }
+
+    // Appends up to k (term, weight) completions of prefix to out, best first
+    void complete(std::string_view prefix, size_t k, std::vector<std::pair<std::string, float>>& out) const {
+        if (header == nullptr || k == 0) return;
+
+        // Walk down to the node whose subtree holds every term starting with prefix
+        uint32_t index = 0;
+        std::string base; // bytes on the path above that node
+        size_t matched = 0;
+        while (true) {
+            std::string_view edge = label(nodes[index]);
+            std::string_view rest = prefix.substr(matched);
+            if (rest.size() <= edge.size()) {
+                if (edge.substr(0, rest.size()) != rest) return;
+                break;
+            }
+            if (rest.substr(0, edge.size()) != edge) return;
+            matched += edge.size();
+            base += edge;
+
+            const CompletionNode& node = nodes[index];
+            uint32_t next = UINT32_MAX;
+            for (uint32_t child = node.firstChild; child < node.firstChild + node.childCount; child++) {
+                if (labels[nodes[child].labelOffset] == prefix[matched]) {
+                    next = child;
+                    break;
+                }
+            }
+            if (next == UINT32_MAX) return;
+            index = next;
+        }
+
+        // Best-first expansion; a term is queued as its node with `word` set
+        struct Entry {
+            uint32_t node;
+            uint32_t parent; // entry the node was reached from, UINT32_MAX for the start
+            bool word;
+        };
+        std::vector<Entry> entries;
+        auto lower = [&](const std::pair<float, uint32_t>& a, const std::pair<float, uint32_t>& b) {
+            return a.first != b.first ? a.first < b.first : a.second > b.second;
+        };
+        std::priority_queue<std::pair<float, uint32_t>, std::vector<std::pair<float, uint32_t>>, decltype(lower)> queue(lower);
+
+        entries.push_back(Entry{index, UINT32_MAX, false});
+        queue.emplace(nodes[index].maxScore, 0);
+        size_t found = 0;
+        std::vector<std::string_view> path;
+        while (!queue.empty() && found < k) {
+            auto [score, at] = queue.top();
+            queue.pop();
+            Entry entry = entries[at];
+            const CompletionNode& node = nodes[entry.node];
+
+            if (entry.word) {
+                path.clear();
+                for (uint32_t i = at; i != UINT32_MAX; i = entries[i].parent)
+                    if (!entries[i].word) path.push_back(label(nodes[entries[i].node]));
+                std::string term = base;
+                for (auto edge = path.rbegin(); edge != path.rend(); ++edge) term += *edge;
+                out.emplace_back(std::move(term), score);
+                found++;
+                continue;
+            }
+
+            if (node.weight >= 0) {
+                entries.push_back(Entry{entry.node, at, true});
+                queue.emplace(node.weight, entries.size() - 1);
+            }
+            for (uint32_t child = node.firstChild; child < node.firstChild + node.childCount; child++) {
+                entries.push_back(Entry{child, at, false});
+                queue.emplace(nodes[child].maxScore, entries.size() - 1);
+            }
+        }
+    }
+};
+
+#endif
@@ -75,18 +75,30 @@ public:
         return nullptr; // Key not found
     }
 
+    const ValueType *find(const KeyType &key) const {
+        size_t index = getBucketIndex(key);
+        for (const auto &pair : buckets[index]) {
+            if (pair.first == key) {
+                return &pair.second;
+            }
+        }
+        return nullptr; // Key not found
+    }
 
-    // ValueType *find(const KeyType &key) const {
-    //     size_t index = getBucketIndex(key);
-    //     for (auto &pair : buckets[index]) {
-    //         if (pair.first == key) {
-    //             return &pair.second;
-    //         }
-    //     }
-    //     return nullptr; // Key not found
-    // }
-
-    ValueType &at(const KeyType &key) const {
+    // Lookup with a key type that hashes and compares equal to KeyType, e.g. a
+    // std::string_view into a HashMap keyed by std::string, without building a KeyType
+    template <typename LookupKey>
+    const ValueType *findAs(const LookupKey &key) const {
+        size_t index = std::hash<LookupKey>{}(key) % bucketCount;
+        for (const auto &pair : buckets[index]) {
+            if (pair.first == key) {
+                return &pair.second;
+            }
+        }
+        return nullptr; // Key not found
+    }
+
+    const ValueType &at(const KeyType &key) const {
         return *find(key);
     }
 
@@ -123,6 +135,10 @@ public:
             }
         }
 
+        if ((double)size / bucketCount >= loadFactorThreshold) {
+            rehash();
+            index = getBucketIndex(key);
+        }
         buckets[index].emplace_back(key, ValueType());
         ++size;
         return buckets[index].back().second;
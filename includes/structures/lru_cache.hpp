@@ -0,0 +1,241 @@
+#ifndef _LRU_CACHE_H_
+#define _LRU_CACHE_H_
+
+#include <list>
+#include <memory>
+#include <iterator>
+#include <algorithm>
+#include <mutex>
+#include <atomic>
+#include <vector>
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+
+//default number of independently locked shards
+#define LRU_CACHE_SHARDS 16
+
+// Frequency sketch used to decide whether a new entry is worth evicting an old one for
+// (TinyLFU admission). Counters are halved every `sampleSize` increments so that
+// popularity decays over time.
+class FrequencySketch {
+private:
+    static const size_t depth = 4;
+
+    std::vector<uint8_t> counters;
+    size_t width;
+    size_t additions;
+    size_t sampleSize;
+
+    size_t indexOf(uint64_t hash, size_t row) const {
+        uint64_t h = hash + row * 0x9E3779B97F4A7C15ULL;
+        h ^= h >> 33;
+        h *= 0xFF51AFD7ED558CCDULL;
+        h ^= h >> 33;
+        return row * width + (h % width);
+    }
+
+    void age() {
+        for (auto &counter : counters) counter >>= 1;
+        additions /= 2;
+    }
+
+public:
+    explicit FrequencySketch(size_t expectedEntries = 1024)
+        : width(expectedEntries < 64 ? 64 : expectedEntries), additions(0), sampleSize(width * 10) {
+        counters.assign(width * depth, 0);
+    }
+
+    void increment(uint64_t hash) {
+        for (size_t row = 0; row < depth; ++row) {
+            uint8_t &counter = counters[indexOf(hash, row)];
+            if (counter < 15) ++counter;
+        }
+        if (++additions >= sampleSize) age();
+    }
+
+    uint8_t frequency(uint64_t hash) const {
+        uint8_t estimate = 15;
+        for (size_t row = 0; row < depth; ++row) {
+            uint8_t counter = counters[indexOf(hash, row)];
+            if (counter < estimate) estimate = counter;
+        }
+        return estimate;
+    }
+
+    void clear() {
+        std::fill(counters.begin(), counters.end(), 0);
+        additions = 0;
+    }
+};
+
+// Concurrent LRU cache bounded by an approximate memory budget. Keys are spread over
+// independently locked shards; each shard runs LRU eviction guarded by a TinyLFU
+// admission filter so one-off keys cannot flush out the popular ones.
+template <typename KeyType, typename ValueType>
+class ShardedLRUCache {
+public:
+    struct Stats {
+        uint64_t hits;
+        uint64_t misses;
+        uint64_t insertions;
+        uint64_t evictions;
+        uint64_t rejections;
+        size_t entries;
+        size_t bytes;
+        size_t capacityBytes;
+
+        double hitRatio() const {
+            uint64_t lookups = hits + misses;
+            return lookups ? (double)hits / lookups : 0.0;
+        }
+    };
+
+private:
+    struct Entry {
+        KeyType key;
+        ValueType value;
+        size_t bytes;
+    };
+
+    typedef std::list<Entry> EntryList;
+
+    struct Shard {
+        std::mutex lock;
+        EntryList order; // most recently used at the front
+        std::unordered_map<KeyType, typename EntryList::iterator> index;
+        FrequencySketch sketch;
+        size_t bytes = 0;
+
+        explicit Shard(size_t expectedEntries) : sketch(expectedEntries) {}
+    };
+
+    std::vector<std::unique_ptr<Shard>> shards;
+    size_t shardCapacity;
+
+    std::atomic<uint64_t> hits{0};
+    std::atomic<uint64_t> misses{0};
+    std::atomic<uint64_t> insertions{0};
+    std::atomic<uint64_t> evictions{0};
+    std::atomic<uint64_t> rejections{0};
+
+    Shard &shardFor(uint64_t hash) {
+        return *shards[(hash >> 7) % shards.size()];
+    }
+
+    void removeEntry(Shard &shard, typename EntryList::iterator it) {
+        shard.bytes -= it->bytes;
+        shard.index.erase(it->key);
+        shard.order.erase(it);
+    }
+
+public:
+    // `expectedEntryBytes` only sizes the frequency sketch; the bound itself is in bytes
+    ShardedLRUCache(size_t capacityBytes, size_t shardCount = LRU_CACHE_SHARDS, size_t expectedEntryBytes = 4096)
+        : shardCapacity(capacityBytes / (shardCount ? shardCount : 1)) {
+        if (shardCount == 0) shardCount = 1;
+        size_t expectedEntries = shardCapacity / (expectedEntryBytes ? expectedEntryBytes : 1);
+        for (size_t i = 0; i < shardCount; ++i) {
+            shards.emplace_back(new Shard(expectedEntries));
+        }
+    }
+
+    ShardedLRUCache(const ShardedLRUCache &) = delete;
+    ShardedLRUCache &operator=(const ShardedLRUCache &) = delete;
+
+    bool get(const KeyType &key, ValueType &out) {
+        uint64_t hash = std::hash<KeyType>{}(key);
+        Shard &shard = shardFor(hash);
+        std::lock_guard<std::mutex> guard(shard.lock);
+
+        shard.sketch.increment(hash);
+        auto found = shard.index.find(key);
+        if (found == shard.index.end()) {
+            misses.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+
+        shard.order.splice(shard.order.begin(), shard.order, found->second);
+        out = found->second->value;
+        hits.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    // `bytes` is the caller's estimate of the entry's footprint (key + value payload)
+    bool put(const KeyType &key, ValueType value, size_t bytes) {
+        if (bytes > shardCapacity) {
+            rejections.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+
+        uint64_t hash = std::hash<KeyType>{}(key);
+        Shard &shard = shardFor(hash);
+        std::lock_guard<std::mutex> guard(shard.lock);
+
+        // A key already cached was admitted before, so it is updated in place and only
+        // makes room for its new size; the eviction loop below never reaches it at the front
+        auto found = shard.index.find(key);
+        if (found != shard.index.end()) {
+            auto entry = found->second;
+            shard.order.splice(shard.order.begin(), shard.order, entry);
+            shard.bytes = shard.bytes - entry->bytes + bytes;
+            entry->value = std::move(value);
+            entry->bytes = bytes;
+            while (shard.bytes > shardCapacity) {
+                removeEntry(shard, std::prev(shard.order.end()));
+                evictions.fetch_add(1, std::memory_order_relaxed);
+            }
+            insertions.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+
+        // Only evict for a candidate that has been asked for more often than the victim
+        uint8_t candidateFrequency = shard.sketch.frequency(hash);
+        while (shard.bytes + bytes > shardCapacity && !shard.order.empty()) {
+            auto victim = std::prev(shard.order.end());
+            uint8_t victimFrequency = shard.sketch.frequency(std::hash<KeyType>{}(victim->key));
+            if (candidateFrequency <= victimFrequency) {
+                rejections.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+            removeEntry(shard, victim);
+            evictions.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        shard.order.push_front(Entry{key, std::move(value), bytes});
+        shard.index[key] = shard.order.begin();
+        shard.bytes += bytes;
+        insertions.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    // Drops every entry and the popularity history, e.g. after the index changes
+    void clear() {
+        for (auto &shard : shards) {
+            std::lock_guard<std::mutex> guard(shard->lock);
+            shard->order.clear();
+            shard->index.clear();
+            shard->sketch.clear();
+            shard->bytes = 0;
+        }
+    }
+
+    Stats stats() {
+        Stats result{};
+        result.hits = hits.load(std::memory_order_relaxed);
+        result.misses = misses.load(std::memory_order_relaxed);
+        result.insertions = insertions.load(std::memory_order_relaxed);
+        result.evictions = evictions.load(std::memory_order_relaxed);
+        result.rejections = rejections.load(std::memory_order_relaxed);
+        result.capacityBytes = shardCapacity * shards.size();
+
+        for (auto &shard : shards) {
+            std::lock_guard<std::mutex> guard(shard->lock);
+            result.entries += shard->order.size();
+            result.bytes += shard->bytes;
+        }
+        return result;
+    }
+};
+
+#endif
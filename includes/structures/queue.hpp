@@ -1,5 +1,9 @@
+#ifndef _QUEUE_H_
+#define _QUEUE_H_
+
 #include <iostream>
 #include <stdexcept>
+#include <utility>
 
 template <typename T>
 class Queue {
@@ -20,9 +24,12 @@ public:
         delete[] data;
     }
 
+    Queue(const Queue&) = delete;
+    Queue& operator=(const Queue&) = delete;
+
     void push(const T& value) {
         if (full()) {
-            throw std::overflow_error("Queue is full");
+            grow();
         }
         rearIndex = (rearIndex + 1) % capacity;
         data[rearIndex] = value;
@@ -33,6 +40,7 @@ public:
         if (empty()) {
             throw std::underflow_error("Queue is empty");
         }
+        data[frontIndex] = T(); // release what the element owns
         frontIndex = (frontIndex + 1) % capacity;
         --count;
     }
@@ -69,6 +77,16 @@ public:
         count = 0;
     }
 
+    // Calls fn on every element from front to back
+    template <typename Fn>
+    void forEach(Fn&& fn) const {
+        size_t index = frontIndex;
+        for (size_t i = 0; i < count; ++i) {
+            fn(data[index]);
+            index = (index + 1) % capacity;
+        }
+    }
+
     void print() const {
         if (empty()) {
             std::cout << "Queue is empty" << std::endl;
@@ -82,4 +100,21 @@ public:
         }
         std::cout << std::endl;
     }
-};
\ No newline at end of file
+
+private:
+    // Doubles the capacity, unwrapping the elements to the start of the new array
+    void grow() {
+        size_t newCapacity = capacity ? capacity * 2 : 1;
+        T* grown = new T[newCapacity];
+        for (size_t i = 0; i < count; ++i) {
+            grown[i] = std::move(data[(frontIndex + i) % capacity]);
+        }
+        delete[] data;
+        data = grown;
+        capacity = newCapacity;
+        frontIndex = 0;
+        rearIndex = count - 1;
+    }
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,128 @@
+#ifndef _SIMHASH_H_
+#define _SIMHASH_H_
+
+#include <mutex>
+#include <atomic>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <string_view>
+#include <unordered_map>
+
+//pages whose fingerprints differ in at most this many bits are near-duplicates
+#define SIMHASH_MAX_DISTANCE 3
+
+inline uint64_t simhashFeature(std::string_view feature) {
+    // FNV-1a followed by a murmur finalizer so that every output bit depends on every byte
+    uint64_t h = 0xCBF29CE484222325ULL;
+    for (unsigned char c : feature) {
+        h ^= c;
+        h *= 0x100000001B3ULL;
+    }
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDULL;
+    h ^= h >> 33;
+    h *= 0xC4CEB9FE1A85EC53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+// Charikar's SimHash: each feature votes its weight up or down on all 64 bits and the
+// fingerprint keeps the sign of every tally, so similar feature sets give fingerprints
+// a small Hamming distance apart
+class SimHash {
+private:
+    int64_t tally[64] = {0};
+
+public:
+    void add(std::string_view feature, int64_t weight = 1) {
+        uint64_t h = simhashFeature(feature);
+        for (int bit = 0; bit < 64; ++bit)
+            tally[bit] += (h >> bit) & 1 ? weight : -weight;
+    }
+
+    uint64_t fingerprint() const {
+        uint64_t result = 0;
+        for (int bit = 0; bit < 64; ++bit)
+            if (tally[bit] > 0) result |= 1ULL << bit;
+        return result;
+    }
+};
+
+// Finds fingerprints within maxDistance bits of each other (Manku et al.). The 64 bits are
+// cut into maxDistance + 1 blocks; two fingerprints that differ in at most maxDistance bits
+// must agree exactly on at least one block, so each block gets a table and only fingerprints
+// sharing a block value are ever compared.
+class SimHashIndex {
+private:
+    struct Block {
+        int shift;
+        uint64_t mask;
+        std::unordered_map<uint64_t, std::vector<uint32_t>> table; // block value -> entries
+    };
+
+    std::mutex indexMutex;
+    std::vector<Block> blocks;
+    std::vector<std::pair<uint64_t, std::string>> entries; // fingerprint, canonical url
+    int maxDistance;
+
+    void buildBlocks() {
+        blocks.clear();
+        int count = maxDistance + 1;
+        int shift = 0;
+        for (int i = 0; i < count; ++i) {
+            int width = 64 / count + (i < 64 % count ? 1 : 0);
+            uint64_t mask = width == 64 ? ~0ULL : ((1ULL << width) - 1);
+            blocks.push_back(Block{shift, mask, {}});
+            shift += width;
+        }
+        for (uint32_t i = 0; i < entries.size(); ++i)
+            for (auto& block : blocks)
+                block.table[(entries[i].first >> block.shift) & block.mask].push_back(i);
+    }
+
+public:
+    std::atomic<uint64_t> duplicates{0};
+
+    explicit SimHashIndex(int maxDistance = SIMHASH_MAX_DISTANCE) : maxDistance(maxDistance) {
+        buildBlocks();
+    }
+
+    void setMaxDistance(int distance) {
+        std::lock_guard<std::mutex> guard(indexMutex);
+        maxDistance = distance < 0 ? 0 : (distance > 63 ? 63 : distance);
+        buildBlocks();
+    }
+
+    // Returns true and sets canonical to the url of an indexed near-duplicate of
+    // fingerprint, or adds fingerprint under url and returns false. The check and the
+    // insert are one step, so of several near-identical pages crawled at once exactly
+    // one becomes canonical.
+    bool findOrInsert(uint64_t fingerprint, const std::string& url, std::string& canonical) {
+        std::lock_guard<std::mutex> guard(indexMutex);
+        for (const auto& block : blocks) {
+            auto candidates = block.table.find((fingerprint >> block.shift) & block.mask);
+            if (candidates == block.table.end()) continue;
+            for (uint32_t i : candidates->second) {
+                if (__builtin_popcountll(entries[i].first ^ fingerprint) <= maxDistance) {
+                    duplicates.fetch_add(1, std::memory_order_relaxed);
+                    canonical = entries[i].second;
+                    return true;
+                }
+            }
+        }
+
+        uint32_t id = entries.size();
+        entries.emplace_back(fingerprint, url);
+        for (auto& block : blocks)
+            block.table[(fingerprint >> block.shift) & block.mask].push_back(id);
+        return false;
+    }
+
+    size_t size() {
+        std::lock_guard<std::mutex> guard(indexMutex);
+        return entries.size();
+    }
+};
+
+#endif
@@ -0,0 +1,119 @@
+#ifndef _SNAPSHOT_H_
+#define _SNAPSHOT_H_
+
+#include <atomic>
+#include <mutex>
+#include <memory>
+#include <thread>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+
+//number of concurrent readers that can hold a snapshot without sharing a slot
+#define SNAPSHOT_READER_SLOTS 256
+
+// Publishes an immutable object to many readers using epoch-based reclamation.
+// Readers never block: they announce the epoch they entered in a slot, read the
+// current pointer and clear the slot when done. A publisher swaps the pointer,
+// advances the epoch and frees the old object once no slot still holds an older epoch.
+template <typename T>
+class SnapshotPublisher {
+private:
+    std::atomic<const T *> current;
+    std::atomic<uint64_t> epoch;
+    std::atomic<uint64_t> readerEpochs[SNAPSHOT_READER_SLOTS];
+    std::mutex publishLock; // serializes publishers only
+
+    static size_t preferredSlot() {
+        static thread_local const size_t slot = std::hash<std::thread::id>{}(std::this_thread::get_id()) % SNAPSHOT_READER_SLOTS;
+        return slot;
+    }
+
+    size_t enter() {
+        size_t slot = preferredSlot();
+        for (;;) {
+            uint64_t expected = 0;
+            uint64_t entered = epoch.load();
+            if (readerEpochs[slot].compare_exchange_weak(expected, entered)) {
+                return slot;
+            }
+            slot = (slot + 1) % SNAPSHOT_READER_SLOTS;
+        }
+    }
+
+    void waitForReadersBefore(uint64_t newEpoch) {
+        for (size_t slot = 0; slot < SNAPSHOT_READER_SLOTS; ++slot) {
+            for (;;) {
+                uint64_t entered = readerEpochs[slot].load();
+                if (entered == 0 || entered >= newEpoch) break;
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        }
+    }
+
+public:
+    // Keeps the snapshot that was current when it was created alive until destruction
+    class ReadGuard {
+    private:
+        SnapshotPublisher *owner;
+        size_t slot;
+        const T *snapshot;
+
+    public:
+        ReadGuard(SnapshotPublisher *owner) : owner(owner), slot(owner->enter()) {
+            snapshot = owner->current.load();
+        }
+
+        ~ReadGuard() {
+            release();
+        }
+
+        // Lets go of the snapshot before the guard goes out of scope; it must not be used after
+        void release() {
+            if (owner) owner->readerEpochs[slot].store(0);
+            owner = nullptr;
+            snapshot = nullptr;
+        }
+
+        ReadGuard(const ReadGuard &) = delete;
+        ReadGuard &operator=(const ReadGuard &) = delete;
+
+        ReadGuard(ReadGuard &&other) noexcept : owner(other.owner), slot(other.slot), snapshot(other.snapshot) {
+            other.owner = nullptr;
+        }
+
+        const T *get() const { return snapshot; }
+        const T *operator->() const { return snapshot; }
+        const T &operator*() const { return *snapshot; }
+        explicit operator bool() const { return snapshot != nullptr; }
+    };
+
+    SnapshotPublisher() : current(nullptr), epoch(1) {
+        for (auto &slot : readerEpochs) slot.store(0);
+    }
+
+    ~SnapshotPublisher() {
+        delete current.load();
+    }
+
+    SnapshotPublisher(const SnapshotPublisher &) = delete;
+    SnapshotPublisher &operator=(const SnapshotPublisher &) = delete;
+
+    ReadGuard read() {
+        return ReadGuard(this);
+    }
+
+    // Makes `next` visible to new readers, then blocks until readers of the
+    // previous snapshot have finished before freeing it
+    void publish(std::unique_ptr<const T> next) {
+        std::lock_guard<std::mutex> guard(publishLock);
+
+        const T *previous = current.exchange(next.release());
+        uint64_t newEpoch = epoch.fetch_add(1) + 1;
+        waitForReadersBefore(newEpoch);
+
+        delete previous;
+    }
+};
+
+#endif
@@ -0,0 +1,221 @@
+#ifndef _SPELLING_INDEX_H_
+#define _SPELLING_INDEX_H_
+
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+#include <algorithm>
+#include <string_view>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+//first bytes of a spelling index file, including the format version
+#define SPELLING_INDEX_MAGIC "SYMDEL01"
+//most characters deleted from a term; candidates further than this are never found
+#define SPELLING_MAX_DISTANCE 2
+//deletes are taken from this many leading characters only, which bounds them per term
+#define SPELLING_PREFIX_LENGTH 7
+
+struct SpellingIndexHeader {
+    char magic[8];
+    uint64_t entries;
+    uint32_t maxDistance;
+    uint32_t prefixLength;
+};
+
+// Hashes of every string made by deleting up to `distance` characters from the first
+// `prefixLength` characters of word, word's prefix itself included. The strings are never
+// built: each is hashed (FNV-1a) straight from word, skipping the deleted positions.
+// Collisions only cost a wasted candidate, which the edit distance check rejects.
+inline void spellingDeleteHashes(std::string_view word, size_t distance, size_t prefixLength, std::vector<uint32_t>& out) {
+    word = word.substr(0, std::min<size_t>(prefixLength, 64));
+    out.clear();
+
+    auto hashSkipping = [&](uint64_t deleted) {
+        uint32_t hash = 2166136261u;
+        for (size_t i = 0; i < word.size(); i++) {
+            if (deleted >> i & 1) continue;
+            hash ^= (unsigned char) word[i];
+            hash *= 16777619u;
+        }
+        return hash;
+    };
+    // Every set of at most `left` more positions, each after `from`
+    auto choose = [&](auto& self, size_t from, size_t left, uint64_t deleted) -> void {
+        out.push_back(hashSkipping(deleted));
+        if (left == 0) return;
+        for (size_t i = from; i < word.size(); i++)
+            self(self, i + 1, left - 1, deleted | 1ULL << i);
+    };
+    choose(choose, 0, distance, 0);
+
+    std::sort(out.begin(), out.end());
+    out.erase(std::unique(out.begin(), out.end()), out.end());
+}
+
+// Optimal string alignment distance (Levenshtein plus adjacent transpositions), or
+// maxDistance + 1 once it is certain to exceed maxDistance
+inline size_t spellingDistance(std::string_view a, std::string_view b, size_t maxDistance) {
+    if (a.size() > b.size()) std::swap(a, b);
+    if (b.size() - a.size() > maxDistance) return maxDistance + 1;
+
+    static thread_local std::vector<size_t> rows[3];
+    for (auto& row : rows) row.assign(b.size() + 1, 0);
+    std::vector<size_t>* before = &rows[0];
+    std::vector<size_t>* previous = &rows[1];
+    std::vector<size_t>* current = &rows[2];
+    for (size_t j = 0; j <= b.size(); j++) (*previous)[j] = j;
+
+    for (size_t i = 1; i <= a.size(); i++) {
+        (*current)[0] = i;
+        size_t best = i;
+        for (size_t j = 1; j <= b.size(); j++) {
+            size_t cost = a[i - 1] == b[j - 1] ? 0 : 1;
+            size_t distance = std::min({(*previous)[j] + 1, (*current)[j - 1] + 1, (*previous)[j - 1] + cost});
+            if (i > 1 && j > 1 && a[i - 1] == b[j - 2] && a[i - 2] == b[j - 1])
+                distance = std::min(distance, (*before)[j - 2] + 1);
+            (*current)[j] = distance;
+            best = std::min(best, distance);
+        }
+        if (best > maxDistance) return maxDistance + 1;
+        std::swap(before, previous);
+        std::swap(previous, current);
+    }
+    return std::min((*previous)[b.size()], maxDistance + 1);
+}
+
+// Collects terms, numbered in the order they are added, and writes the symmetric-delete
+// index over them
+class SpellingIndexBuilder {
+private:
+    std::vector<std::pair<uint32_t, uint32_t>> entries; // delete hash, term id
+    std::vector<uint32_t> deletes;
+    uint32_t count = 0;
+
+public:
+    void add(std::string_view term) {
+        spellingDeleteHashes(term, SPELLING_MAX_DISTANCE, SPELLING_PREFIX_LENGTH, deletes);
+        for (uint32_t hash : deletes)
+            entries.emplace_back(hash, count);
+        count++;
+    }
+
+    // Written to a temporary file that is renamed over path, so a reader never maps half a file
+    bool write(const std::string& path) {
+        std::sort(entries.begin(), entries.end());
+        entries.erase(std::unique(entries.begin(), entries.end()), entries.end());
+
+        std::string temporary = path + ".tmp";
+        FILE* out = fopen(temporary.c_str(), "wb");
+        if (out == nullptr) return false;
+
+        SpellingIndexHeader header;
+        memcpy(header.magic, SPELLING_INDEX_MAGIC, sizeof(header.magic));
+        header.entries = entries.size();
+        header.maxDistance = SPELLING_MAX_DISTANCE;
+        header.prefixLength = SPELLING_PREFIX_LENGTH;
+
+        bool ok = fwrite(&header, sizeof(header), 1, out) == 1;
+        for (const auto& [hash, term] : entries)
+            ok &= fwrite(&hash, sizeof(hash), 1, out) == 1;
+        for (const auto& [hash, term] : entries)
+            ok &= fwrite(&term, sizeof(term), 1, out) == 1;
+        ok &= fclose(out) == 0;
+        if (!ok || rename(temporary.c_str(), path.c_str()) != 0) {
+            remove(temporary.c_str());
+            return false;
+        }
+        return true;
+    }
+};
+
+// Symmetric-delete spelling candidates (Garbe, SymSpell). Two strings within edit distance
+// d share a string reachable from both by at most d deletes, so every term's deletes are
+// hashed ahead of time; a lookup computes the word's own deletes, a few dozen, and each is
+// one binary search in the mapped hash array. Only the terms found that way get an edit
+// distance computed, instead of every term in the dictionary.
+class SpellingIndex {
+private:
+    const char* mapping = nullptr;
+    size_t length = 0;
+    const SpellingIndexHeader* header = nullptr;
+    const uint32_t* hashes = nullptr; // sorted
+    const uint32_t* terms = nullptr;  // term id of each hash
+
+public:
+    SpellingIndex() = default;
+    SpellingIndex(const SpellingIndex&) = delete;
+    SpellingIndex& operator=(const SpellingIndex&) = delete;
+
+    ~SpellingIndex() {
+        close();
+    }
+
+    // Maps the index at path; false if it can't be read or isn't a spelling index
+    bool open(const std::string& path) {
+        close();
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        struct stat info;
+        if (fstat(fd, &info) != 0 || (size_t) info.st_size < sizeof(SpellingIndexHeader)) {
+            ::close(fd);
+            return false;
+        }
+        length = info.st_size;
+        void* mapped = mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (mapped == MAP_FAILED) {
+            length = 0;
+            return false;
+        }
+        mapping = (const char*) mapped;
+
+        header = (const SpellingIndexHeader*) mapping;
+        hashes = (const uint32_t*) (mapping + sizeof(SpellingIndexHeader));
+        terms = hashes + header->entries;
+        bool valid = memcmp(header->magic, SPELLING_INDEX_MAGIC, sizeof(header->magic)) == 0 &&
+                     sizeof(SpellingIndexHeader) + header->entries * 2 * sizeof(uint32_t) == length;
+        if (!valid) close();
+        return valid;
+    }
+
+    void close() {
+        if (mapping != nullptr) munmap((void*) mapping, length);
+        mapping = nullptr;
+        length = 0;
+        header = nullptr;
+    }
+
+    // Bytes mapped
+    size_t bytes() const {
+        return length;
+    }
+
+    // Calls fn(term id) once for every term that may be within maxDistance of word, capped
+    // at the distance the index was built for. Callers check the actual distance.
+    template <typename Fn>
+    void forEachCandidate(std::string_view word, size_t maxDistance, Fn&& fn) const {
+        if (header == nullptr) return;
+        static thread_local std::vector<uint32_t> deletes;
+        static thread_local std::vector<uint32_t> found;
+
+        spellingDeleteHashes(word, std::min<size_t>(maxDistance, header->maxDistance), header->prefixLength, deletes);
+        found.clear();
+        const uint32_t* end = hashes + header->entries;
+        for (uint32_t hash : deletes) {
+            for (const uint32_t* at = std::lower_bound(hashes, end, hash); at != end && *at == hash; ++at)
+                found.push_back(terms[at - hashes]);
+        }
+        std::sort(found.begin(), found.end());
+        found.erase(std::unique(found.begin(), found.end()), found.end());
+        for (uint32_t term : found)
+            fn(term);
+    }
+};
+
+#endif
@@ -0,0 +1,322 @@
+#ifndef _TERM_DICTIONARY_H_
+#define _TERM_DICTIONARY_H_
+
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <string_view>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+//terms per front-coded block; a lookup binary searches the blocks, then scans one
+#define TERM_DICTIONARY_BLOCK 16
+//first bytes of a dictionary file, including the format version
+#define TERM_DICTIONARY_MAGIC "TERMDIC1"
+
+// File layout: the header, then one offset per block into the data, then the data. Every
+// term is stored as varint(bytes shared with the previous term), varint(suffix length),
+// suffix. The first term of a block shares nothing, so decoding can start at any block.
+struct TermDictionaryHeader {
+    char magic[8];
+    uint64_t terms;
+    uint64_t blocks;
+    uint64_t dataBytes;
+};
+
+// Collects terms in increasing byte order and writes them as a front-coded dictionary.
+// The id of a term is its position in that order.
+class TermDictionaryBuilder {
+private:
+    std::string data;
+    std::vector<uint64_t> blockOffsets;
+    std::string previous;
+    uint64_t count = 0;
+
+    void putVarint(uint64_t value) {
+        while (value >= 0x80) {
+            data.push_back((char) (value | 0x80));
+            value >>= 7;
+        }
+        data.push_back((char) value);
+    }
+
+public:
+    // False, and the term is ignored, unless it sorts after every term added before it
+    bool add(std::string_view term) {
+        if (count > 0 && term <= std::string_view(previous)) return false;
+
+        size_t shared = 0;
+        if (count % TERM_DICTIONARY_BLOCK == 0) {
+            blockOffsets.push_back(data.size());
+        } else {
+            size_t limit = std::min(previous.size(), term.size());
+            while (shared < limit && previous[shared] == term[shared]) shared++;
+        }
+        putVarint(shared);
+        putVarint(term.size() - shared);
+        data.append(term.data() + shared, term.size() - shared);
+
+        previous.assign(term.data(), term.size());
+        count++;
+        return true;
+    }
+
+    size_t size() const {
+        return count;
+    }
+
+    // Written to a temporary file that is renamed over path, so a reader never maps half a file
+    bool write(const std::string& path) const {
+        std::string temporary = path + ".tmp";
+        FILE* out = fopen(temporary.c_str(), "wb");
+        if (out == nullptr) return false;
+
+        TermDictionaryHeader header;
+        memcpy(header.magic, TERM_DICTIONARY_MAGIC, sizeof(header.magic));
+        header.terms = count;
+        header.blocks = blockOffsets.size();
+        header.dataBytes = data.size();
+
+        bool ok = fwrite(&header, sizeof(header), 1, out) == 1;
+        ok &= fwrite(blockOffsets.data(), sizeof(uint64_t), blockOffsets.size(), out) == blockOffsets.size();
+        ok &= fwrite(data.data(), 1, data.size(), out) == data.size();
+        ok &= fclose(out) == 0;
+        if (!ok || rename(temporary.c_str(), path.c_str()) != 0) {
+            remove(temporary.c_str());
+            return false;
+        }
+        return true;
+    }
+};
+
+// Read-only view of a dictionary written by TermDictionaryBuilder. The file is mapped, not
+// read, so the dictionary costs a few bytes per term plus an offset and an 8-byte key per
+// block. A lookup binary searches the blocks' keys and decodes at most one block; since
+// terms are sorted, all terms with a prefix sit next to each other and are enumerated by
+// decoding forward from the first of them.
+class TermDictionary {
+private:
+    const char* mapping = nullptr;
+    size_t length = 0;
+    const TermDictionaryHeader* header = nullptr;
+    const uint64_t* blockOffsets = nullptr;
+    const uint8_t* data = nullptr;
+    std::vector<uint64_t> blockKeys; // first 8 bytes of each block's first term, big-endian, zero padded
+
+    // Orders like the string it was taken from, except that strings sharing their first 8
+    // bytes compare equal
+    static uint64_t keyOf(std::string_view term) {
+        uint64_t key = 0;
+        for (size_t i = 0; i < 8; i++)
+            key = (key << 8) | (i < term.size() ? (unsigned char) term[i] : 0);
+        return key;
+    }
+
+    static uint64_t getVarint(const uint8_t*& p) {
+        uint64_t value = 0;
+        for (int shift = 0;; shift += 7) {
+            uint8_t byte = *p++;
+            value |= (uint64_t) (byte & 0x7F) << shift;
+            if (byte < 0x80) return value;
+        }
+    }
+
+    std::string_view firstTerm(uint64_t block) const {
+        const uint8_t* p = data + blockOffsets[block];
+        getVarint(p); // always 0
+        uint64_t size = getVarint(p);
+        return std::string_view((const char*) p, size);
+    }
+
+    // Last block whose first term is <= term, or 0. The keys settle it unless blocks start
+    // with the same 8 bytes as term; only then are the terms themselves compared.
+    uint64_t findBlock(std::string_view term) const {
+        uint64_t key = keyOf(term);
+        uint64_t low = std::lower_bound(blockKeys.begin(), blockKeys.end(), key) - blockKeys.begin();
+        uint64_t high = std::upper_bound(blockKeys.begin() + low, blockKeys.end(), key) - blockKeys.begin();
+        if (low == high) return low > 0 ? low - 1 : 0;
+
+        low = low > 0 ? low - 1 : 0;
+        if (firstTerm(low) > term) return low;
+        while (high - low > 1) {
+            uint64_t middle = low + (high - low) / 2;
+            if (firstTerm(middle) <= term)
+                low = middle;
+            else
+                high = middle;
+        }
+        return low;
+    }
+
+public:
+    static constexpr uint64_t npos = UINT64_MAX;
+
+    // Decodes terms one after the other from any block start
+    class Cursor {
+    private:
+        const TermDictionary* dictionary;
+        const uint8_t* p;
+        uint64_t next;
+        std::string current;
+
+    public:
+        Cursor(const TermDictionary* dictionary, uint64_t block)
+            : dictionary(dictionary), next(block * TERM_DICTIONARY_BLOCK) {
+            size_t blocks = dictionary->size() ? dictionary->header->blocks : 0;
+            p = block < blocks ? dictionary->data + dictionary->blockOffsets[block] : nullptr;
+        }
+
+        // Moves to the next term; false past the last one
+        bool advance() {
+            if (p == nullptr || next >= dictionary->size()) return false;
+            uint64_t shared = getVarint(p);
+            uint64_t suffix = getVarint(p);
+            current.resize(shared);
+            current.append((const char*) p, suffix);
+            p += suffix;
+            next++;
+            return true;
+        }
+
+        std::string_view term() const {
+            return current;
+        }
+
+        uint64_t id() const {
+            return next - 1;
+        }
+    };
+
+    TermDictionary() = default;
+    TermDictionary(const TermDictionary&) = delete;
+    TermDictionary& operator=(const TermDictionary&) = delete;
+
+    ~TermDictionary() {
+        close();
+    }
+
+    // Maps the dictionary at path; false if it can't be read or isn't a dictionary
+    bool open(const std::string& path) {
+        close();
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        struct stat info;
+        if (fstat(fd, &info) != 0 || (size_t) info.st_size < sizeof(TermDictionaryHeader)) {
+            ::close(fd);
+            return false;
+        }
+        length = info.st_size;
+        void* mapped = mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (mapped == MAP_FAILED) {
+            length = 0;
+            return false;
+        }
+        mapping = (const char*) mapped;
+
+        header = (const TermDictionaryHeader*) mapping;
+        blockOffsets = (const uint64_t*) (mapping + sizeof(TermDictionaryHeader));
+        data = (const uint8_t*) (blockOffsets + header->blocks);
+        bool valid = memcmp(header->magic, TERM_DICTIONARY_MAGIC, sizeof(header->magic)) == 0 &&
+                     header->blocks == (header->terms + TERM_DICTIONARY_BLOCK - 1) / TERM_DICTIONARY_BLOCK &&
+                     sizeof(TermDictionaryHeader) + header->blocks * sizeof(uint64_t) + header->dataBytes == length;
+        if (!valid) {
+            close();
+            return false;
+        }
+
+        blockKeys.resize(header->blocks);
+        for (uint64_t block = 0; block < header->blocks; block++)
+            blockKeys[block] = keyOf(firstTerm(block));
+        return true;
+    }
+
+    void close() {
+        if (mapping != nullptr) munmap((void*) mapping, length);
+        mapping = nullptr;
+        length = 0;
+        header = nullptr;
+        std::vector<uint64_t>().swap(blockKeys);
+    }
+
+    size_t size() const {
+        return header ? header->terms : 0;
+    }
+
+    // Bytes mapped, plus the block keys held in memory
+    size_t bytes() const {
+        return length + blockKeys.size() * sizeof(uint64_t);
+    }
+
+    // Id of term, or npos
+    uint64_t find(std::string_view term) const {
+        if (size() == 0) return npos;
+        uint64_t block = findBlock(term);
+        uint64_t end = std::min<uint64_t>(header->terms, (block + 1) * TERM_DICTIONARY_BLOCK);
+
+        // Terms are scanned without being rebuilt: matched is how much of term the previous
+        // entry agreed with. An entry sharing less than that with the previous one is already
+        // past term, one sharing more still sorts before it, and only one sharing exactly that
+        // much needs its suffix compared.
+        const uint8_t* p = data + blockOffsets[block];
+        size_t matched = 0;
+        for (uint64_t id = block * TERM_DICTIONARY_BLOCK; id < end; id++) {
+            uint64_t shared = getVarint(p);
+            uint64_t suffix = getVarint(p);
+            const char* bytes = (const char*) p;
+            p += suffix;
+
+            if (shared > matched) continue;
+            if (shared < matched) return npos;
+
+            size_t i = 0, limit = std::min<size_t>(suffix, term.size() - matched);
+            while (i < limit && bytes[i] == term[matched + i]) i++;
+            if (i == suffix && matched + i == term.size()) return id;
+            if (i < limit ? (unsigned char) bytes[i] > (unsigned char) term[matched + i] : i < suffix) return npos;
+            matched += i;
+        }
+        return npos;
+    }
+
+    // Cursor positioned before the first term >= term; advance() moves onto it
+    Cursor lowerBound(std::string_view term) const {
+        if (size() == 0) return begin();
+        uint64_t block = findBlock(term);
+        Cursor probe(this, block);
+        uint64_t before = 0; // terms of the block that sort before term
+        while (before < TERM_DICTIONARY_BLOCK && probe.advance() && probe.term() < term) before++;
+
+        Cursor cursor(this, block);
+        for (uint64_t i = 0; i < before; i++) cursor.advance();
+        return cursor;
+    }
+
+    // Cursor before the first term
+    Cursor begin() const {
+        return Cursor(this, 0);
+    }
+
+    // Calls fn(term, id) for every term starting with prefix, in order, until fn returns false
+    template <typename Fn>
+    void forEachWithPrefix(std::string_view prefix, Fn&& fn) const {
+        Cursor cursor = lowerBound(prefix);
+        while (cursor.advance() && cursor.term().substr(0, prefix.size()) == prefix) {
+            if (!fn(cursor.term(), cursor.id())) return;
+        }
+    }
+
+    // The term with this id
+    std::string term(uint64_t id) const {
+        if (id >= size()) return std::string();
+        Cursor cursor(this, id / TERM_DICTIONARY_BLOCK);
+        for (uint64_t i = id % TERM_DICTIONARY_BLOCK; cursor.advance() && i > 0; i--) {}
+        return std::string(cursor.term());
+    }
+};
+
+#endif
@@ -0,0 +1,200 @@
+#ifndef _TOKENIZER_H_
+#define _TOKENIZER_H_
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <string_view>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define TOKENIZER_X86 1
+#endif
+
+//bytes classified per mask word
+#define TOKENIZER_BLOCK 32
+
+// Lowercases the ASCII letters of `in` into `out` and sets bit i of masks[i / 32] for
+// every byte that is a letter. `length` must be a multiple of TOKENIZER_BLOCK.
+typedef void (*ClassifyKernel)(const char* in, char* out, size_t length, uint32_t* masks);
+
+inline void classify_scalar(const char* in, char* out, size_t length, uint32_t* masks) {
+    for (size_t block = 0; block < length; block += TOKENIZER_BLOCK) {
+        uint32_t mask = 0;
+        for (size_t i = 0; i < TOKENIZER_BLOCK; ++i) {
+            unsigned char c = in[block + i];
+            unsigned char lower = c | 0x20;
+            bool letter = (unsigned char)(lower - 'a') < 26;
+            out[block + i] = letter ? lower : c;
+            mask |= (uint32_t)letter << i;
+        }
+        masks[block / TOKENIZER_BLOCK] = mask;
+    }
+}
+
+#ifdef TOKENIZER_X86
+
+// A byte is a letter when (byte | 0x20) - 'a' is below 26 as an unsigned value;
+// min_epu8(t, 25) == t tests that without a signed compare
+inline void classify_sse2(const char* in, char* out, size_t length, uint32_t* masks) {
+    const __m128i caseBit = _mm_set1_epi8(0x20);
+    const __m128i a = _mm_set1_epi8('a');
+    const __m128i span = _mm_set1_epi8(25);
+
+    for (size_t block = 0; block < length; block += TOKENIZER_BLOCK) {
+        uint32_t mask = 0;
+        for (size_t half = 0; half < TOKENIZER_BLOCK; half += 16) {
+            __m128i bytes = _mm_loadu_si128((const __m128i*)(in + block + half));
+            __m128i lower = _mm_or_si128(bytes, caseBit);
+            __m128i offset = _mm_sub_epi8(lower, a);
+            __m128i letter = _mm_cmpeq_epi8(_mm_min_epu8(offset, span), offset);
+            __m128i folded = _mm_or_si128(_mm_and_si128(letter, lower), _mm_andnot_si128(letter, bytes));
+            _mm_storeu_si128((__m128i*)(out + block + half), folded);
+            mask |= (uint32_t)_mm_movemask_epi8(letter) << half;
+        }
+        masks[block / TOKENIZER_BLOCK] = mask;
+    }
+}
+
+__attribute__((target("avx2")))
+inline void classify_avx2(const char* in, char* out, size_t length, uint32_t* masks) {
+    const __m256i caseBit = _mm256_set1_epi8(0x20);
+    const __m256i a = _mm256_set1_epi8('a');
+    const __m256i span = _mm256_set1_epi8(25);
+
+    for (size_t block = 0; block < length; block += TOKENIZER_BLOCK) {
+        __m256i bytes = _mm256_loadu_si256((const __m256i*)(in + block));
+        __m256i lower = _mm256_or_si256(bytes, caseBit);
+        __m256i offset = _mm256_sub_epi8(lower, a);
+        __m256i letter = _mm256_cmpeq_epi8(_mm256_min_epu8(offset, span), offset);
+        _mm256_storeu_si256((__m256i*)(out + block), _mm256_blendv_epi8(bytes, lower, letter));
+        masks[block / TOKENIZER_BLOCK] = (uint32_t)_mm256_movemask_epi8(letter);
+    }
+}
+
+#endif
+
+// Splits text into maximal runs of ASCII letters, lowercased. Bytes are classified a
+// block at a time with AVX2 or SSE2 when the CPU has them (checked once), falling back
+// to scalar code. Tokens are views into a scratch buffer owned by the tokenizer, so
+// after the first few calls tokenizing allocates nothing. One tokenizer per thread.
+class AsciiTokenizer {
+public:
+    struct Kernel {
+        ClassifyKernel classify;
+        const char* name;
+    };
+
+private:
+    std::string lowered;
+    std::vector<uint32_t> masks;
+
+    static Kernel selectKernel() {
+#ifdef TOKENIZER_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) return {classify_avx2, "avx2"};
+        if (__builtin_cpu_supports("sse2")) return {classify_sse2, "sse2"};
+#endif
+        return {classify_scalar, "scalar"};
+    }
+
+    // Lowercases text into the scratch buffer and sets the letter bits; returns the
+    // classified length, rounded up to a whole block
+    size_t classifyText(std::string_view text) {
+        size_t length = text.length();
+        size_t whole = length - length % TOKENIZER_BLOCK;
+        size_t padded = whole + (length % TOKENIZER_BLOCK ? TOKENIZER_BLOCK : 0);
+        if (lowered.size() < padded) lowered.resize(padded);
+        if (masks.size() < padded / TOKENIZER_BLOCK) masks.resize(padded / TOKENIZER_BLOCK);
+
+        ClassifyKernel classify = kernel().classify;
+        classify(text.data(), &lowered[0], whole, masks.data());
+        if (padded != whole) {
+            // the tail goes through a zero padded block; padding is never a letter
+            char tail[TOKENIZER_BLOCK] = {0};
+            memcpy(tail, text.data() + whole, length - whole);
+            classify(tail, &lowered[whole], TOKENIZER_BLOCK, masks.data() + whole / TOKENIZER_BLOCK);
+        }
+        return padded;
+    }
+
+    // Emits every maximal run of set bits in the masks as a token
+    template <typename Emit>
+    void emitRuns(size_t length, size_t padded, Emit&& emit) {
+        bool inToken = false;
+        size_t tokenStart = 0;
+        for (size_t block = 0; block < padded; block += TOKENIZER_BLOCK) {
+            uint64_t letters = masks[block / TOKENIZER_BLOCK];
+            size_t bit = 0;
+            while (bit < TOKENIZER_BLOCK) {
+                uint64_t remaining = ~0ULL << bit;
+                if (inToken) {
+                    uint64_t others = ~letters & 0xFFFFFFFFULL & remaining;
+                    if (others == 0) break; // token runs into the next block
+                    size_t end = __builtin_ctzll(others);
+                    emit(std::string_view(lowered.data() + tokenStart, block + end - tokenStart), tokenStart);
+                    inToken = false;
+                    bit = end + 1;
+                } else {
+                    uint64_t starts = letters & remaining;
+                    if (starts == 0) break;
+                    size_t start = __builtin_ctzll(starts);
+                    tokenStart = block + start;
+                    inToken = true;
+                    bit = start + 1;
+                }
+            }
+        }
+        if (inToken) {
+            emit(std::string_view(lowered.data() + tokenStart, length - tokenStart), tokenStart);
+        }
+    }
+
+public:
+    // Picked once from what the CPU supports
+    static const Kernel& kernel() {
+        static const Kernel selected = selectKernel();
+        return selected;
+    }
+
+    static AsciiTokenizer& local() {
+        static thread_local AsciiTokenizer tokenizer;
+        return tokenizer;
+    }
+
+    // Calls emit(token, offset) for every token, where offset is the token's position
+    // in `text`. The view is only valid until emit returns.
+    template <typename Emit>
+    void forEachToken(std::string_view text, Emit&& emit) {
+        size_t padded = classifyText(text);
+        emitRuns(text.length(), padded, emit);
+    }
+
+    // Like forEachToken, except that '*' and '?' count as letters, so wildcard patterns
+    // such as optim* or c?t come out whole. A '?' at either end of a run is punctuation,
+    // as in "how does it work?", and is left out. Runs without a letter are skipped.
+    template <typename Emit>
+    void forEachPattern(std::string_view text, Emit&& emit) {
+        size_t padded = classifyText(text);
+        for (size_t i = 0; i < text.length(); i++) {
+            if (text[i] == '*' || text[i] == '?') masks[i / TOKENIZER_BLOCK] |= 1u << (i % TOKENIZER_BLOCK);
+        }
+        emitRuns(text.length(), padded, [&](std::string_view token, size_t offset) {
+            size_t first = token.find_first_not_of('?');
+            if (first == std::string_view::npos) return;
+            token = token.substr(first, token.find_last_not_of('?') + 1 - first);
+            if (token.find_first_not_of("*?") != std::string_view::npos) emit(token, offset + first);
+        });
+    }
+
+    // Number of tokens in text
+    size_t count(std::string_view text) {
+        size_t tokens = 0;
+        forEachToken(text, [&](std::string_view, size_t) { ++tokens; });
+        return tokens;
+    }
+};
+
+#endif
@@ -0,0 +1,250 @@
+#ifndef _TRIGRAM_INDEX_H_
+#define _TRIGRAM_INDEX_H_
+
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+#include <algorithm>
+#include <string_view>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+//first bytes of a trigram index file, including the format version
+#define TRIGRAM_INDEX_MAGIC "TRIGRAM1"
+//marks the start and end of a term, so trigrams can also anchor a pattern at either end
+#define TRIGRAM_BOUNDARY '\0'
+
+// File layout: the header, the sorted trigrams padded to a multiple of 8 bytes, for each
+// trigram the offset of its postings plus one past the last, then the postings: ids of the
+// terms containing the trigram, in increasing order.
+struct TrigramIndexHeader {
+    char magic[8];
+    uint64_t trigrams;
+    uint64_t postings;
+};
+
+inline bool isWildcard(char c) {
+    return c == '*' || c == '?';
+}
+
+inline bool hasWildcard(std::string_view pattern) {
+    return std::any_of(pattern.begin(), pattern.end(), isWildcard);
+}
+
+// Glob match where * stands for any run of characters and ? for exactly one. Backtracks
+// only to the last *, so it runs in O(pattern * text) at worst.
+inline bool wildcardMatch(std::string_view pattern, std::string_view text) {
+    size_t p = 0, t = 0, star = std::string_view::npos, resume = 0;
+    while (t < text.size()) {
+        if (p < pattern.size() && (pattern[p] == '?' || pattern[p] == text[t])) {
+            p++;
+            t++;
+        } else if (p < pattern.size() && pattern[p] == '*') {
+            star = p++;
+            resume = t;
+        } else if (star != std::string_view::npos) {
+            p = star + 1;
+            t = ++resume;
+        } else {
+            return false;
+        }
+    }
+    while (p < pattern.size() && pattern[p] == '*') p++;
+    return p == pattern.size();
+}
+
+// Calls fn(trigram) for every trigram of the term framed by TRIGRAM_BOUNDARY, skipping any
+// that span a wildcard, whose characters aren't known
+template <typename Fn>
+void forEachTrigram(std::string_view term, Fn&& fn) {
+    std::string framed;
+    framed.reserve(term.size() + 2);
+    framed += TRIGRAM_BOUNDARY;
+    framed += term;
+    framed += TRIGRAM_BOUNDARY;
+    for (size_t i = 0; i + 3 <= framed.size(); i++) {
+        if (isWildcard(framed[i]) || isWildcard(framed[i + 1]) || isWildcard(framed[i + 2])) continue;
+        fn((uint32_t) (unsigned char) framed[i] << 16 | (uint32_t) (unsigned char) framed[i + 1] << 8 | (unsigned char) framed[i + 2]);
+    }
+}
+
+// Collects terms, numbered in the order they are added, and writes the trigram index over them
+class TrigramIndexBuilder {
+private:
+    std::vector<std::pair<uint32_t, uint32_t>> entries; // trigram, term id
+    uint32_t count = 0;
+
+public:
+    void add(std::string_view term) {
+        size_t first = entries.size();
+        forEachTrigram(term, [&](uint32_t trigram) { entries.emplace_back(trigram, count); });
+        // A trigram repeated within the term is listed once
+        std::sort(entries.begin() + first, entries.end());
+        entries.erase(std::unique(entries.begin() + first, entries.end()), entries.end());
+        count++;
+    }
+
+    // Written to a temporary file that is renamed over path, so a reader never maps half a file
+    bool write(const std::string& path) {
+        std::sort(entries.begin(), entries.end());
+
+        std::vector<uint32_t> trigrams;
+        std::vector<uint64_t> offsets;
+        for (size_t i = 0; i < entries.size(); i++) {
+            if (i == 0 || entries[i].first != entries[i - 1].first) {
+                trigrams.push_back(entries[i].first);
+                offsets.push_back(i);
+            }
+        }
+        offsets.push_back(entries.size());
+
+        std::string temporary = path + ".tmp";
+        FILE* out = fopen(temporary.c_str(), "wb");
+        if (out == nullptr) return false;
+
+        TrigramIndexHeader header;
+        memcpy(header.magic, TRIGRAM_INDEX_MAGIC, sizeof(header.magic));
+        header.trigrams = trigrams.size();
+        header.postings = entries.size();
+
+        uint32_t pad = 0;
+        bool ok = fwrite(&header, sizeof(header), 1, out) == 1;
+        ok &= fwrite(trigrams.data(), sizeof(uint32_t), trigrams.size(), out) == trigrams.size();
+        if (trigrams.size() % 2) ok &= fwrite(&pad, sizeof(pad), 1, out) == 1;
+        ok &= fwrite(offsets.data(), sizeof(uint64_t), offsets.size(), out) == offsets.size();
+        for (const auto& [trigram, term] : entries)
+            ok &= fwrite(&term, sizeof(term), 1, out) == 1;
+        ok &= fclose(out) == 0;
+        if (!ok || rename(temporary.c_str(), path.c_str()) != 0) {
+            remove(temporary.c_str());
+            return false;
+        }
+        return true;
+    }
+};
+
+// Finds the terms that may match a wildcard pattern (Zobel and Dart; Manning et al.,
+// "Introduction to Information Retrieval" 3.2.2). Every term is indexed under the trigrams
+// of the term framed by boundary markers (^ and $ below), so "optim*" needs the trigrams
+// "^op", "opt", "pti" and "tim", and "*tion" needs "tio", "ion" and "on$". Intersecting their postings,
+// shortest first, leaves a small superset of the matches, which callers verify with
+// wildcardMatch.
+class TrigramIndex {
+private:
+    const char* mapping = nullptr;
+    size_t length = 0;
+    const TrigramIndexHeader* header = nullptr;
+    const uint32_t* trigrams = nullptr;
+    const uint64_t* offsets = nullptr;
+    const uint32_t* postings = nullptr;
+
+public:
+    TrigramIndex() = default;
+    TrigramIndex(const TrigramIndex&) = delete;
+    TrigramIndex& operator=(const TrigramIndex&) = delete;
+
+    ~TrigramIndex() {
+        close();
+    }
+
+    // Maps the index at path; false if it can't be read or isn't a trigram index
+    bool open(const std::string& path) {
+        close();
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        struct stat info;
+        if (fstat(fd, &info) != 0 || (size_t) info.st_size < sizeof(TrigramIndexHeader)) {
+            ::close(fd);
+            return false;
+        }
+        length = info.st_size;
+        void* mapped = mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (mapped == MAP_FAILED) {
+            length = 0;
+            return false;
+        }
+        mapping = (const char*) mapped;
+
+        header = (const TrigramIndexHeader*) mapping;
+        size_t trigramBytes = (header->trigrams * sizeof(uint32_t) + 7) & ~(size_t) 7;
+        trigrams = (const uint32_t*) (mapping + sizeof(TrigramIndexHeader));
+        offsets = (const uint64_t*) ((const char*) trigrams + trigramBytes);
+        postings = (const uint32_t*) (offsets + header->trigrams + 1);
+        bool valid = memcmp(header->magic, TRIGRAM_INDEX_MAGIC, sizeof(header->magic)) == 0 &&
+                     sizeof(TrigramIndexHeader) + trigramBytes + (header->trigrams + 1) * sizeof(uint64_t) +
+                     header->postings * sizeof(uint32_t) == length;
+        if (!valid) close();
+        return valid;
+    }
+
+    void close() {
+        if (mapping != nullptr) munmap((void*) mapping, length);
+        mapping = nullptr;
+        length = 0;
+        header = nullptr;
+    }
+
+    bool isOpen() const {
+        return header != nullptr;
+    }
+
+    // Bytes mapped
+    size_t bytes() const {
+        return length;
+    }
+
+    // Replaces out with the ids of the terms holding every trigram of pattern, in increasing
+    // order. False when the pattern has no trigram to narrow the terms down with, such as
+    // "a*" or "*x*", or when the index isn't open.
+    bool candidates(std::string_view pattern, std::vector<uint32_t>& out) const {
+        out.clear();
+        if (header == nullptr) return false;
+
+        std::vector<uint32_t> wanted;
+        forEachTrigram(pattern, [&](uint32_t trigram) { wanted.push_back(trigram); });
+        if (wanted.empty()) return false;
+        std::sort(wanted.begin(), wanted.end());
+        wanted.erase(std::unique(wanted.begin(), wanted.end()), wanted.end());
+
+        std::vector<std::pair<const uint32_t*, const uint32_t*>> lists;
+        const uint32_t* end = trigrams + header->trigrams;
+        for (uint32_t trigram : wanted) {
+            const uint32_t* at = std::lower_bound(trigrams, end, trigram);
+            if (at == end || *at != trigram) return true; // no term has it
+            size_t i = at - trigrams;
+            lists.emplace_back(postings + offsets[i], postings + offsets[i + 1]);
+        }
+        std::sort(lists.begin(), lists.end(), [](const auto& a, const auto& b) { return a.second - a.first < b.second - b.first; });
+
+        // Each remaining candidate is looked up in the next list by galloping ahead from the
+        // last position, so a short list against a long one costs about log of the gap
+        out.assign(lists[0].first, lists[0].second);
+        for (size_t l = 1; l < lists.size() && !out.empty(); l++) {
+            const uint32_t* at = lists[l].first;
+            const uint32_t* stop = lists[l].second;
+            size_t kept = 0;
+            for (uint32_t term : out) {
+                size_t step = 1;
+                const uint32_t* probe = at;
+                while (probe < stop && *probe < term) {
+                    at = probe;
+                    probe = at + step;
+                    step *= 2;
+                }
+                at = std::lower_bound(at, std::min(probe, stop), term);
+                if (at == stop) break;
+                if (*at == term) out[kept++] = term;
+            }
+            out.resize(kept);
+        }
+        return true;
+    }
+};
+
+#endif
@@ -1,175 +1,249 @@
 #include <iostream>
-//#include <unordered_map>
 #include <vector>
 #include <string>
 #include <cmath>
+#include <cstdio>
 #include <fstream>
+#include <thread>
+#include <charconv>
 #include <omp.h>
 #include <nlohmann/json.hpp>
-#include "structure/hashmap.hpp"
+#include "structures/hashmap.hpp"
+#include "structures/term_dictionary.hpp"
+#include "structures/completion_trie.hpp"
+#include "structures/spelling_index.hpp"
+#include "structures/trigram_index.hpp"
+#include "spimi.hpp"
 
 using namespace std;
 using json = nlohmann::json;
 
+//postings the keyword index may hold in memory before a sorted run is written, in megabytes
+#define SPIMI_MEMORY_BUDGET_MB 256
+//bytes of output a merge thread gathers before writing them
+#define TFIDF_WRITE_BUFFER (1 << 20)
+
+// The link graph over dense URL ids. inbound[inboundStart[i] .. inboundStart[i + 1]) are
+// the pages linking to page i, once per link
+struct LinkGraph {
+    vector<string> urls;
+    vector<uint32_t> outDegree;
+    vector<uint32_t> inboundStart;
+    vector<uint32_t> inbound;
+    vector<pair<uint32_t, uint32_t>> links; // source, target; emptied by creatingInboundLinksMapping
+};
+
 // Function Prototypes
-void fileReadUrl_OutgoingLinks(HashMap<string, vector<string>>& url_OutgoingLinks);
-HashMap<string, vector<string>> creatingInboundLinksMapping(const HashMap<string, vector<string>>& url_OutgoingLinks);
-HashMap<string, pair<double, vector<string>>> initializePageRank(const HashMap<string, vector<string>>& url_OutgoingLinks);
-double getPageRankContributionFromPages(const HashMap<string, pair<double, vector<string>>>& outboundLinksWithPageRank, const HashMap<string, vector<string>>& inboundLinks_URL, const string& url);
-void calculateFinalPageRanks(HashMap<string, pair<double, vector<string>>>& outboundLinksWithPageRank, const HashMap<string, vector<string>>& inboundLinks_URL);
-void writePageRankToFile(const HashMap<string, pair<double, vector<string>>>& outboundLinksWithPageRank);
+bool fileReadUrl_OutgoingLinks(LinkGraph& graph);
+void creatingInboundLinksMapping(LinkGraph& graph);
+vector<double> calculateFinalPageRanks(const LinkGraph& graph);
+void writePageRankToFile(const LinkGraph& graph, const vector<double>& pageRanks);
 
-void fileReadkeyWords_Urls(HashMap<string, vector<pair<string, double>>>& keyWords_Urls);
-void TF_IDFcalculation(HashMap<string, vector<pair<string, double>>>& keyWords_Urls);
-void writeTFIDFToFile(const HashMap<string, vector<pair<string, double>>>& keyWords_Urls);
+bool fileReadkeyWords_Urls(SpimiBuilder& keyWords_Urls);
+double TF_IDFcalculation(double relativeFrequency, size_t numberOfDocsContainingTerm, size_t numberOfDocs);
+bool writeTFIDFToFile(SpimiBuilder& keyWords_Urls, size_t threads);
 
 // Main Function
-int main() {
-    // Initializing data structures
-    cout << "running" << endl;
-    HashMap<string, vector<pair<string, double>>> keyWords_Urls;
-    HashMap<string, vector<string>> url_OutgoingLinks;
-
-    // Reading the data set
-    fileReadkeyWords_Urls(keyWords_Urls);
-    fileReadUrl_OutgoingLinks(url_OutgoingLinks);
-
-    // TF-IDF Calculation
-    TF_IDFcalculation(keyWords_Urls);
-    cout << "TF-IDF WROTE TO FILE" << endl;
+int main(int argc, char* argv[]) {
+    size_t memoryBudget = (size_t) SPIMI_MEMORY_BUDGET_MB << 20;
+    size_t threads = max(1u, thread::hardware_concurrency());
+
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        // ./indexer --memory-mb 64
+        if (arg == "--memory-mb" && i + 1 < argc) {
+            memoryBudget = (size_t) max(1L, atol(argv[++i])) << 20;
+        }
+        // ./indexer --threads 4
+        else if (arg == "--threads" && i + 1 < argc) {
+            threads = max(1L, atol(argv[++i]));
+        }
+    }
 
-    // Initialize inbound and outbound links
-    HashMap<string, vector<string>> inboundLinks_URL = creatingInboundLinksMapping(url_OutgoingLinks);
-    HashMap<string, pair<double, vector<string>>> outboundLinksWithPageRank = initializePageRank(url_OutgoingLinks);
+    cout << "running" << endl;
 
-    // Calculate final PageRanks
-    calculateFinalPageRanks(outboundLinksWithPageRank, inboundLinks_URL);
-    cout << "PAGE RANK WROTE TO FILE" << endl;
+    // TF-IDF Calculation: keywords are inverted in blocks that fit the memory budget and
+    // merged into the index with their weights
+    {
+        SpimiBuilder keyWords_Urls(memoryBudget, "../jsonFiles/tfidf_output.json.run");
+        if (fileReadkeyWords_Urls(keyWords_Urls) && writeTFIDFToFile(keyWords_Urls, threads))
+            cout << "TF-IDF WROTE TO FILE" << endl;
+    }
 
-    writeTFIDFToFile(keyWords_Urls);
-    writePageRankToFile(outboundLinksWithPageRank);
+    // PageRank over the link graph
+    LinkGraph graph;
+    if (fileReadUrl_OutgoingLinks(graph)) {
+        creatingInboundLinksMapping(graph);
+        writePageRankToFile(graph, calculateFinalPageRanks(graph));
+        cout << "PAGE RANK WROTE TO FILE" << endl;
+    }
 
     return 0;
 }
 
-void fileReadUrl_OutgoingLinks(HashMap<string, vector<string>>& url_OutgoingLinks) {
-    json tempJson;
-    ifstream inputFile("../jsonFiles/outgoingLinks.json");
-    if (!inputFile.is_open()) {
-        cerr << "Error: Could not open the file: " << "outgoingLinks.json" << endl;
-        return;
+// SAX events that aren't needed are accepted and ignored
+struct JsonReader : json::json_sax_t {
+    int depth = 0; // objects and arrays open
+
+    bool null() override { return true; }
+    bool boolean(bool) override { return true; }
+    bool number_integer(number_integer_t) override { return true; }
+    bool number_unsigned(number_unsigned_t) override { return true; }
+    bool number_float(number_float_t, const string_t&) override { return true; }
+    bool string(string_t&) override { return true; }
+    bool binary(binary_t&) override { return true; }
+    bool key(string_t&) override { return true; }
+    bool start_object(size_t) override { depth++; return true; }
+    bool end_object() override { depth--; return true; }
+    bool start_array(size_t) override { depth++; return true; }
+    bool end_array() override { depth--; return true; }
+
+    bool parse_error(size_t position, const std::string&, const nlohmann::detail::exception& error) override {
+        cerr << "Error: JSON parse error at byte " << position << ": " << error.what() << endl;
+        return false;
+    }
+};
+
+// outgoingLinks.json: {"url": ["linked url", ...], ...}
+struct OutgoingLinksReader : JsonReader {
+    LinkGraph& graph;
+    HashMap<std::string, uint32_t> ids;
+    uint32_t source = 0;
+
+    explicit OutgoingLinksReader(LinkGraph& graph) : graph(graph) {}
+
+    // Ensure all URLs are included
+    uint32_t page(const std::string& url) {
+        if (const uint32_t* id = ids.find(url)) return *id;
+        uint32_t id = graph.urls.size();
+        ids.insert({url, id});
+        graph.urls.push_back(url);
+        graph.outDegree.push_back(0);
+        return id;
     }
 
-    inputFile >> tempJson;
+    bool key(string_t& url) override {
+        if (depth == 1) source = page(url);
+        return true;
+    }
 
-    for (const auto& [key, value] : tempJson.items()) {
-        if (value.is_array()) {
-            for (const auto& outgoingUrl : value) {
-                url_OutgoingLinks[key].emplace_back(outgoingUrl.get<string>());
-                // Ensure all URLs are included
-                if (url_OutgoingLinks.find(outgoingUrl) == url_OutgoingLinks.end()) {
-                    url_OutgoingLinks[outgoingUrl] = {};
-                }
-            }
-        }
-        // Ensure all URLs are included
-        if (url_OutgoingLinks.find(key) == url_OutgoingLinks.end()) {
-            url_OutgoingLinks[key] = {};
+    bool string(string_t& url) override {
+        if (depth == 2) {
+            uint32_t target = page(url);
+            graph.links.emplace_back(source, target);
+            graph.outDegree[source]++;
         }
+        return true;
     }
-}
+};
 
-HashMap<string, vector<string>> creatingInboundLinksMapping(const HashMap<string, vector<string>>& url_OutgoingLinks) {
-    HashMap<string, vector<string>> inboundLinks_URL;
+// keywords_domains.json: {"keyword": [{"url": relative frequency}, ...], ...}
+struct KeyWordsReader : JsonReader {
+    SpimiBuilder& keyWords_Urls;
+    std::string keyword;
+    uint32_t doc = 0;
+    bool failed = false;
 
-    #pragma omp parallel for
-    for (const auto& [sourceUrl, outgoingUrls] : url_OutgoingLinks) {
-        for (const auto& targetUrl : outgoingUrls) {
-            // Add the source URL as an inbound link for the target URL
-            inboundLinks_URL[targetUrl].push_back(sourceUrl);
-        }
+    explicit KeyWordsReader(SpimiBuilder& keyWords_Urls) : keyWords_Urls(keyWords_Urls) {}
+
+    bool key(string_t& name) override {
+        if (depth == 1) keyword = name;
+        else if (depth == 3) doc = keyWords_Urls.document(name);
+        return true;
     }
 
-    return inboundLinks_URL;
-}
+    bool add(double count) {
+        if (depth == 3 && !keyWords_Urls.add(keyword, doc, (float) count)) {
+            cerr << "Error: Could not write a sorted run of the keyword index" << endl;
+            failed = true;
+            return false;
+        }
+        return true;
+    }
 
-HashMap<string, pair<double, vector<string>>> initializePageRank(const HashMap<string, vector<string>>& url_OutgoingLinks) {
-    HashMap<string, pair<double, vector<string>>> pageRankMap;
-    size_t numberOfDocs = url_OutgoingLinks.size();
-    double initialPageRank = 1.0 / numberOfDocs;
+    bool number_integer(number_integer_t count) override { return add(count); }
+    bool number_unsigned(number_unsigned_t count) override { return add(count); }
+    bool number_float(number_float_t count, const string_t&) override { return add(count); }
+};
 
-    for (const auto& entry : url_OutgoingLinks) {
-        const string& url = entry.first;
-        pageRankMap[url] = {initialPageRank, entry.second};  // Initialize PageRank and outbound links
+bool fileReadUrl_OutgoingLinks(LinkGraph& graph) {
+    ifstream inputFile("../jsonFiles/outgoingLinks.json");
+    if (!inputFile.is_open()) {
+        cerr << "Error: Could not open the file: " << "outgoingLinks.json" << endl;
+        return false;
     }
 
-    return pageRankMap;
+    OutgoingLinksReader reader(graph);
+    return json::sax_parse(inputFile, &reader);
 }
 
-double getPageRankContributionFromPages(const HashMap<string, pair<double, vector<string>>>& outboundLinksWithPageRank, const HashMap<string, vector<string>>& inboundLinks_URL, const string& url) {
-    double contribution = 0.0;
-
-    // Check if the URL exists in the inboundLinks_URL map
-    if (inboundLinks_URL.find(url) != inboundLinks_URL.end()) {
-        vector<string> inboundUrls = inboundLinks_URL.at(url);
-
-        for (const string& incomingUrl : inboundUrls) {
-            const auto& [pageRank, outboundLinks] = outboundLinksWithPageRank.at(incomingUrl);
-            if (!outboundLinks.empty()) {
-                contribution += pageRank / outboundLinks.size();  // Contribution from each inbound link
-            }
-        }
+void creatingInboundLinksMapping(LinkGraph& graph) {
+    size_t numberOfPages = graph.urls.size();
+
+    // Counting sort of the links by target
+    graph.inboundStart.assign(numberOfPages + 1, 0);
+    for (const auto& [sourceUrl, targetUrl] : graph.links)
+        graph.inboundStart[targetUrl + 1]++;
+    for (size_t i = 0; i < numberOfPages; i++)
+        graph.inboundStart[i + 1] += graph.inboundStart[i];
+
+    vector<uint32_t> next(graph.inboundStart.begin(), graph.inboundStart.end() - 1);
+    graph.inbound.resize(graph.links.size());
+    for (const auto& [sourceUrl, targetUrl] : graph.links) {
+        // Add the source URL as an inbound link for the target URL
+        graph.inbound[next[targetUrl]++] = sourceUrl;
     }
 
-    return contribution;
+    vector<pair<uint32_t, uint32_t>>().swap(graph.links);
 }
 
-void calculateFinalPageRanks(HashMap<string, pair<double, vector<string>>>& outboundLinksWithPageRank, const HashMap<string, vector<string>>& inboundLinks_URL) {
+vector<double> calculateFinalPageRanks(const LinkGraph& graph) {
     const double errorMargin = 0.0001;
     const double dampingFactor = 0.85;
-    double noOfPages = outboundLinksWithPageRank.size();
+    long noOfPages = graph.urls.size();
+    if (noOfPages == 0) return {};
+
     double teleportationProb = (1 - dampingFactor) / noOfPages;
+    vector<double> pageRanks(noOfPages, 1.0 / noOfPages), newPageRanks(noOfPages);
     double error;
 
     do {
         error = 0.0;  // Reset error for this iteration
-        HashMap<string, double> newPageRanks;
         double sinkPageRank = 0.0;
 
         #pragma omp parallel for reduction(+:sinkPageRank)
-        for (const auto& [url, data] : outboundLinksWithPageRank) {
-            const auto& [currentPageRank, outboundLinks] = data;
-            if (outboundLinks.empty()) {
-                sinkPageRank += currentPageRank;
+        for (long page = 0; page < noOfPages; page++) {
+            if (graph.outDegree[page] == 0) {
+                sinkPageRank += pageRanks[page];
             }
         }
 
         #pragma omp parallel for reduction(+:error)
-        for (auto& [url, data] : outboundLinksWithPageRank) {
-            auto& [currentPageRank, outboundLinks] = data;
-
-            double newPageRank = teleportationProb + dampingFactor * (sinkPageRank / noOfPages + getPageRankContributionFromPages(outboundLinksWithPageRank, inboundLinks_URL, url));
+        for (long page = 0; page < noOfPages; page++) {
+            // Contribution from each inbound link
+            double contribution = 0.0;
+            for (uint32_t i = graph.inboundStart[page]; i < graph.inboundStart[page + 1]; i++) {
+                uint32_t incomingPage = graph.inbound[i];
+                contribution += pageRanks[incomingPage] / graph.outDegree[incomingPage];
+            }
 
-            error += abs(newPageRank - currentPageRank);
-            newPageRanks[url] = newPageRank;
+            newPageRanks[page] = teleportationProb + dampingFactor * (sinkPageRank / noOfPages + contribution);
+            error += abs(newPageRanks[page] - pageRanks[page]);
         }
 
         // Update the PageRanks
-        for (auto& [url, data] : outboundLinksWithPageRank) {
-            data.first = newPageRanks[url];
-        }
+        pageRanks.swap(newPageRanks);
 
     } while (error > errorMargin);
-}
 
-void writePageRankToFile(const HashMap<string, pair<double, vector<string>>>& outboundLinksWithPageRank) {
-    json pageRankJson;
+    return pageRanks;
+}
 
-    for (const auto& entry : outboundLinksWithPageRank) {
-        string url = entry.first;
-        double pageRank = entry.second.first;
+void writePageRankToFile(const LinkGraph& graph, const vector<double>& pageRanks) {
+    json pageRankJson = json::object();
 
-        pageRankJson[url] = pageRank;
+    for (size_t page = 0; page < pageRanks.size(); page++) {
+        pageRankJson[graph.urls[page]] = pageRanks[page];
     }
 
     // Write to file
@@ -183,78 +257,158 @@ void writePageRankToFile(const HashMap<string, pair<double, vector<string>>>& ou
     outputFile.close();
 }
 
-void fileReadkeyWords_Urls(HashMap<string, vector<pair<string,double>>> &keyWords_Urls)
+bool fileReadkeyWords_Urls(SpimiBuilder& keyWords_Urls)
 {
-    json tempJson;
     ifstream inputFile("../jsonFiles/keywords_domains.json");
     if( !inputFile.is_open())
     {
-        cerr << "Error: Could not open the file keywords_domains.json";
-        return;
+        cerr << "Error: Could not open the file keywords_domains.json" << endl;
+        return false;
     }
 
-    inputFile >> tempJson;
-
-    for ( const auto& [ key, value] : tempJson.items() )
-        if ( value.is_array())
-            for ( const auto& obj:value)
-                if ( obj.is_object() ) 
-                    for (const auto& [url, count] : obj.items()) 
-                        if (count.is_number()) 
-                            keyWords_Urls[key].emplace_back(url, count.get<double>());
-
+    // Streamed, so only the block being inverted is ever in memory
+    KeyWordsReader reader(keyWords_Urls);
+    return json::sax_parse(inputFile, &reader) && !reader.failed;
 }
 
-void TF_IDFcalculation(  HashMap<string , vector< pair<string,double> > > &keyWords_Urls )
+double TF_IDFcalculation(double relativeFrequency, size_t numberOfDocsContainingTerm, size_t numberOfDocs)
 {
-    size_t NumberOfDocs = keyWords_Urls.size();
-
+    // Calculate idf
+    double inverseDocumentFrequency = log( static_cast<double> (numberOfDocs) / ( 1 + numberOfDocsContainingTerm) );
 
-    #pragma omp parallel for
-    for ( const auto& entry : keyWords_Urls)
-    {
-        string key = entry.first;
-        vector< pair<string,double> > vec = entry.second;
-        double numberOfDocsContainingTerm = vec.size();
-
-        // Calculate idf
-        double inverseDocumentFrequency = log ( static_cast<double> (NumberOfDocs) / ( 1 + numberOfDocsContainingTerm) );
-        
-        //Calculate tf-idf and store it
-        // here the int will be replaced with relative fequency so each doc has actual tdidf
-        for ( auto& entryInVector : vec )
-        {
-            double relativeFrequency =  entryInVector.second;
-            entryInVector.second = relativeFrequency * inverseDocumentFrequency ;
-        }
-    }
+    return relativeFrequency * inverseDocumentFrequency;
 }
 
-void writeTFIDFToFile(const HashMap<string, vector<pair<string, double>>>& keyWords_Urls)
+bool writeTFIDFToFile(SpimiBuilder& keyWords_Urls, size_t threads)
 {
-    json tfidfJson;
+    const string outputPath = "../jsonFiles/tfidf_output.json";
+    size_t numberOfDocs = keyWords_Urls.documentCount();
+
+    // URLs are escaped once rather than once per keyword they appear under
+    vector<string> escapedUrls(numberOfDocs);
+    for (uint32_t doc = 0; doc < numberOfDocs; doc++)
+        escapedUrls[doc] = json(keyWords_Urls.url(doc)).dump();
+
+    // Every merge thread writes its range of keywords to a part file of its own
+    vector<FILE*> parts(threads);
+    vector<string> buffers(threads);
+    vector<vector<pair<string, uint32_t>>> keywords(threads); // each part's keywords and document frequencies, in order
+    vector<size_t> terms(threads), postings(threads);
+    bool opened = true;
+    for (size_t i = 0; i < threads; i++) {
+        parts[i] = fopen((outputPath + ".part" + to_string(i)).c_str(), "w+b");
+        opened &= parts[i] != nullptr;
+    }
+
+    auto closeParts = [&]() {
+        for (size_t i = 0; i < threads; i++) {
+            if (parts[i] == nullptr) continue;
+            fclose(parts[i]);
+            remove((outputPath + ".part" + to_string(i)).c_str());
+        }
+    };
 
-    for (const auto& entry : keyWords_Urls) {
-        string key = entry.first;
-        json keywordsArray;
+    if (!opened) {
+        cerr << "Error: Could not open the file to write TF-IDF data." << endl;
+        closeParts();
+        return false;
+    }
 
-        for (const auto& keyword : entry.second) {
-            json keywordObject;
-            keywordObject["url"] = keyword.first;
-            keywordObject["tfidf"] = keyword.second;
-            keywordsArray.push_back(keywordObject);
+    bool merged = keyWords_Urls.merge(threads, [&](size_t part, const string& keyword, const vector<Posting>& docs) {
+        string& out = buffers[part];
+        if (terms[part]++ > 0) out += ",\n";
+        out += "    ";
+        out += json(keyword).dump();
+        out += ": [";
+
+        char number[32];
+        for (size_t i = 0; i < docs.size(); i++) {
+            double tfidf = TF_IDFcalculation(docs[i].weight, docs.size(), numberOfDocs);
+            auto written = to_chars(number, number + sizeof(number), tfidf);
+
+            out += i == 0 ? "\n        {\"url\": " : ",\n        {\"url\": ";
+            out += escapedUrls[docs[i].doc];
+            out += ", \"tfidf\": ";
+            out.append(number, written.ptr);
+            out += "}";
         }
+        out += "\n    ]";
+        postings[part] += docs.size();
+        keywords[part].emplace_back(keyword, docs.size());
 
-        tfidfJson[key] = keywordsArray;
+        if (out.size() >= TFIDF_WRITE_BUFFER) {
+            fwrite(out.data(), 1, out.size(), parts[part]);
+            out.clear();
+        }
+    });
+    if (!merged) {
+        cerr << "Error: Could not write a sorted run of the keyword index" << endl;
+        closeParts();
+        return false;
     }
 
-    // Write to file
-    ofstream outputFile("../jsonFiles/tfidf_output.json");
-    if (!outputFile.is_open()) {
+    // The parts hold consecutive ranges of keywords, so the index is their concatenation
+    FILE* outputFile = fopen(outputPath.c_str(), "wb");
+    if (outputFile == nullptr) {
         cerr << "Error: Could not open the file to write TF-IDF data." << endl;
-        return;
+        closeParts();
+        return false;
     }
 
-    outputFile << tfidfJson.dump(4);  // Dump the JSON with indentation of 4 spaces
-    outputFile.close();
-}
\ No newline at end of file
+    size_t totalTerms = 0, totalPostings = 0;
+    bool first = true;
+    vector<char> chunk(TFIDF_WRITE_BUFFER);
+    fputs("{\n", outputFile);
+    for (size_t i = 0; i < threads; i++) {
+        fwrite(buffers[i].data(), 1, buffers[i].size(), parts[i]);
+        totalTerms += terms[i];
+        totalPostings += postings[i];
+        if (terms[i] == 0) continue;
+
+        if (!first) fputs(",\n", outputFile);
+        first = false;
+        rewind(parts[i]);
+        for (size_t got; (got = fread(chunk.data(), 1, chunk.size(), parts[i])) > 0;)
+            fwrite(chunk.data(), 1, got, outputFile);
+    }
+    fputs("\n}\n", outputFile);
+    bool written = fclose(outputFile) == 0;
+    closeParts();
+
+    // The keywords in index order, front-coded, for search to map, a completion trie that
+    // ranks them by the number of documents they appear in, their symmetric deletes for
+    // spelling correction and their trigrams for wildcard queries
+    TermDictionaryBuilder dictionary;
+    CompletionTrieBuilder completions;
+    SpellingIndexBuilder spelling;
+    TrigramIndexBuilder trigrams;
+    for (auto& part : keywords) {
+        for (const auto& [keyword, documentFrequency] : part) {
+            dictionary.add(keyword);
+            completions.add(keyword, documentFrequency);
+            spelling.add(keyword);
+            trigrams.add(keyword);
+        }
+        vector<pair<string, uint32_t>>().swap(part);
+    }
+    if (!dictionary.write("../jsonFiles/terms.dict")) {
+        cerr << "Error: Could not write the term dictionary." << endl;
+        written = false;
+    }
+    if (!completions.write("../jsonFiles/completions.trie")) {
+        cerr << "Error: Could not write the completion trie." << endl;
+        written = false;
+    }
+    if (!spelling.write("../jsonFiles/spelling.sym")) {
+        cerr << "Error: Could not write the spelling index." << endl;
+        written = false;
+    }
+    if (!trigrams.write("../jsonFiles/trigrams.idx")) {
+        cerr << "Error: Could not write the trigram index." << endl;
+        written = false;
+    }
+
+    cout << "index: " << totalTerms << " keywords, " << totalPostings << " postings over " << numberOfDocs << " documents, "
+         << keyWords_Urls.runCount() << " sorted runs merged on " << threads << " threads" << endl;
+    return written;
+}
@@ -0,0 +1,251 @@
+#ifndef _SPIMI_H_
+#define _SPIMI_H_
+
+#include <queue>
+#include <thread>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdint>
+#include <iterator>
+#include <algorithm>
+#include <unordered_map>
+
+//a sorted run keeps every this many terms' offsets in memory, so a merge can start mid-run
+#define SPIMI_SAMPLE_INTERVAL 64
+//rough per-term cost of the block's hash table node, key and vector header
+#define SPIMI_TERM_OVERHEAD 96
+
+// A term's occurrence in one document and its weight there
+struct Posting {
+    uint32_t doc;
+    float weight;
+};
+
+// Single-pass in-memory indexing (Heinz and Zobel; Manning et al., "Introduction to
+// Information Retrieval" 4.3). Postings are inverted into an in-memory block until its
+// estimated size reaches the memory budget; the block is then written out as a run sorted
+// by term and cleared. merge() finally reads all runs at once and hands every term with its
+// postings, in term order, to the caller. Terms are split into ranges, one per thread, and
+// each thread k-way merges its range from every run, so peak memory is the budget plus
+// one read buffer per run and thread whatever the size of the corpus.
+class SpimiBuilder {
+private:
+    struct Run {
+        std::string path;
+        std::vector<std::pair<std::string, uint64_t>> samples; // every SPIMI_SAMPLE_INTERVAL-th term and its offset
+    };
+
+    // Reads a run's terms in order, starting at an offset
+    class RunReader {
+    private:
+        FILE* file = nullptr;
+
+    public:
+        std::string term;
+        std::vector<Posting> postings;
+        bool valid = false;
+
+        RunReader(const std::string& path, uint64_t offset) {
+            file = fopen(path.c_str(), "rb");
+            if (file != nullptr) {
+                setvbuf(file, nullptr, _IOFBF, 1 << 16);
+                fseeko(file, offset, SEEK_SET);
+            }
+        }
+
+        ~RunReader() {
+            if (file != nullptr) fclose(file);
+        }
+
+        RunReader(const RunReader&) = delete;
+        RunReader& operator=(const RunReader&) = delete;
+
+        bool next() {
+            uint32_t length, count;
+            valid = file != nullptr && fread(&length, sizeof(length), 1, file) == 1;
+            if (!valid) return false;
+            term.resize(length);
+            valid = fread(&term[0], 1, length, file) == length && fread(&count, sizeof(count), 1, file) == 1;
+            if (!valid) return false;
+            postings.resize(count);
+            valid = fread(postings.data(), sizeof(Posting), count, file) == count;
+            return valid;
+        }
+    };
+
+    size_t memoryBudget;
+    std::string runPrefix;
+    std::unordered_map<std::string, std::vector<Posting>> block;
+    size_t blockBytes = 0;
+    std::vector<Run> runs;
+    size_t runsWritten = 0;
+    std::unordered_map<std::string, uint32_t> docIds;
+    std::vector<std::string> urls;
+
+    // Writes the block as a run sorted by term and empties it
+    bool spill() {
+        if (block.empty()) return true;
+
+        std::vector<std::unordered_map<std::string, std::vector<Posting>>::iterator> terms;
+        terms.reserve(block.size());
+        for (auto it = block.begin(); it != block.end(); ++it)
+            terms.push_back(it);
+        std::sort(terms.begin(), terms.end(), [](const auto& a, const auto& b) { return a->first < b->first; });
+
+        Run run;
+        run.path = runPrefix + std::to_string(runs.size());
+        FILE* out = fopen(run.path.c_str(), "wb");
+        if (out == nullptr) return false;
+        setvbuf(out, nullptr, _IOFBF, 1 << 20);
+
+        uint64_t offset = 0;
+        bool ok = true;
+        for (size_t i = 0; i < terms.size(); i++) {
+            const std::string& term = terms[i]->first;
+            const std::vector<Posting>& postings = terms[i]->second;
+            if (i % SPIMI_SAMPLE_INTERVAL == 0) run.samples.emplace_back(term, offset);
+
+            uint32_t length = term.size(), count = postings.size();
+            ok &= fwrite(&length, sizeof(length), 1, out) == 1;
+            ok &= fwrite(term.data(), 1, length, out) == length;
+            ok &= fwrite(&count, sizeof(count), 1, out) == 1;
+            ok &= fwrite(postings.data(), sizeof(Posting), count, out) == count;
+            offset += sizeof(length) + length + sizeof(count) + count * sizeof(Posting);
+        }
+        ok &= fclose(out) == 0;
+
+        runs.push_back(std::move(run));
+        runsWritten++;
+        block.clear();
+        blockBytes = 0;
+        return ok;
+    }
+
+    // Merges the terms in [lower, upper) from every run; an empty upper means no bound
+    template <typename Emit>
+    void mergeRange(const std::string& lower, const std::string& upper, Emit& emit) const {
+        std::vector<std::unique_ptr<RunReader>> readers;
+        for (const auto& run : runs) {
+            // Start at the last sampled term below the range
+            uint64_t offset = 0;
+            auto after = std::lower_bound(run.samples.begin(), run.samples.end(), lower,
+                                          [](const auto& sample, const std::string& term) { return sample.first < term; });
+            if (after != run.samples.begin()) offset = std::prev(after)->second;
+
+            auto reader = std::make_unique<RunReader>(run.path, offset);
+            while (reader->next() && reader->term < lower) {}
+            readers.push_back(std::move(reader));
+        }
+
+        // Min-heap of runs by current term; ties go to the earlier run, keeping postings in run order
+        auto later = [&](size_t a, size_t b) {
+            return readers[a]->term != readers[b]->term ? readers[a]->term > readers[b]->term : a > b;
+        };
+        std::priority_queue<size_t, std::vector<size_t>, decltype(later)> heap(later);
+        for (size_t i = 0; i < readers.size(); i++)
+            if (readers[i]->valid && (upper.empty() || readers[i]->term < upper)) heap.push(i);
+
+        std::string term;
+        std::vector<Posting> postings;
+        while (!heap.empty()) {
+            term = readers[heap.top()]->term;
+            postings.clear();
+            while (!heap.empty() && readers[heap.top()]->term == term) {
+                size_t i = heap.top();
+                heap.pop();
+                postings.insert(postings.end(), readers[i]->postings.begin(), readers[i]->postings.end());
+                if (readers[i]->next() && (upper.empty() || readers[i]->term < upper)) heap.push(i);
+            }
+            emit(term, postings);
+        }
+    }
+
+public:
+    // Runs are written to runPrefix0, runPrefix1, ... and removed by merge()
+    SpimiBuilder(size_t memoryBudget, std::string runPrefix) : memoryBudget(memoryBudget), runPrefix(std::move(runPrefix)) {}
+
+    ~SpimiBuilder() {
+        removeRuns();
+    }
+
+    SpimiBuilder(const SpimiBuilder&) = delete;
+    SpimiBuilder& operator=(const SpimiBuilder&) = delete;
+
+    // Dense id of a document, assigned the first time its URL is seen
+    uint32_t document(const std::string& url) {
+        auto [it, inserted] = docIds.try_emplace(url, urls.size());
+        if (inserted) urls.push_back(url);
+        return it->second;
+    }
+
+    const std::string& url(uint32_t doc) const {
+        return urls[doc];
+    }
+
+    size_t documentCount() const {
+        return urls.size();
+    }
+
+    // Sorted runs written so far, including those already merged
+    size_t runCount() const {
+        return runsWritten;
+    }
+
+    // Adds one posting; false if a full block could not be written out
+    bool add(const std::string& term, uint32_t doc, float weight) {
+        auto [it, inserted] = block.try_emplace(term);
+        if (inserted) blockBytes += SPIMI_TERM_OVERHEAD + term.capacity();
+
+        std::vector<Posting>& postings = it->second;
+        size_t capacity = postings.capacity();
+        postings.push_back(Posting{doc, weight});
+        blockBytes += (postings.capacity() - capacity) * sizeof(Posting);
+
+        return blockBytes < memoryBudget || spill();
+    }
+
+    // Writes out what is left in memory and calls emit(part, term, postings) for every term
+    // in term order. Terms are cut into `parts` ranges of about equal size, merged on their
+    // own threads; part i holds terms that all sort before those of part i + 1, and emit
+    // is never called concurrently for the same part.
+    template <typename Emit>
+    bool merge(size_t parts, Emit&& emit) {
+        if (!spill()) return false;
+
+        // Range boundaries are quantiles of the sampled terms of all runs
+        std::vector<std::string> sampled;
+        for (const auto& run : runs)
+            for (const auto& sample : run.samples)
+                sampled.push_back(sample.first);
+        std::sort(sampled.begin(), sampled.end());
+        sampled.erase(std::unique(sampled.begin(), sampled.end()), sampled.end());
+        parts = std::max<size_t>(1, std::min(parts, sampled.size()));
+
+        std::vector<std::string> bounds(parts + 1); // bounds[0] is "" (no lower bound), bounds[parts] "" (no upper)
+        for (size_t i = 1; i < parts; i++)
+            bounds[i] = sampled[i * sampled.size() / parts];
+
+        std::vector<std::thread> threads;
+        for (size_t i = 0; i < parts; i++) {
+            threads.emplace_back([this, i, &bounds, &emit] {
+                auto emitPart = [&](const std::string& term, const std::vector<Posting>& postings) { emit(i, term, postings); };
+                mergeRange(bounds[i], bounds[i + 1], emitPart);
+            });
+        }
+        for (auto& thread : threads)
+            thread.join();
+
+        removeRuns();
+        return true;
+    }
+
+    void removeRuns() {
+        for (const auto& run : runs)
+            remove(run.path.c_str());
+        runs.clear();
+    }
+};
+
+#endif
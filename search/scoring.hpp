@@ -0,0 +1,209 @@
+#ifndef _SCORING_H_
+#define _SCORING_H_
+
+#include <cmath>
+#include <limits>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <utility>
+#include <memory_resource>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SCORING_X86 1
+#endif
+
+// Weight of the cosine similarity and the PageRank prior in the final score
+#define COSINE_WEIGHT 0.7f
+#define PAGERANK_WEIGHT 0.3f
+
+// (doc id, score) pairs produced by the final scan
+typedef std::pmr::vector<std::pair<uint32_t, float>> ScoredDocs;
+
+// Dense per-document score state, one per worker thread. A document's slots are
+// only valid when its epoch matches the current query's epoch, so starting a new
+// query is a single increment instead of clearing the arrays.
+struct ScoreAccumulator {
+    std::vector<uint32_t> epochs;
+    std::vector<float> dot_products;
+    std::vector<float> magnitudes;
+    uint32_t epoch = 0;
+    uint32_t min_doc = 0; // range of doc ids touched by the current query
+    uint32_t max_doc = 0;
+
+    void begin_query(size_t doc_count) {
+        if (epochs.size() != doc_count) {
+            epochs.assign(doc_count, 0);
+            dot_products.assign(doc_count, 0);
+            magnitudes.assign(doc_count, 0);
+            epoch = 0;
+        }
+        if (++epoch == 0) { // wrapped around, old tags could look current again
+            std::fill(epochs.begin(), epochs.end(), 0);
+            epoch = 1;
+        }
+        min_doc = std::numeric_limits<uint32_t>::max();
+        max_doc = 0;
+    }
+
+    static ScoreAccumulator &local() {
+        static thread_local ScoreAccumulator accumulator;
+        return accumulator;
+    }
+};
+
+// Adds one term's postings into the accumulator
+typedef void (*AccumulateKernel)(ScoreAccumulator &acc, const uint32_t *docs, const float *weights, size_t count, float query_weight);
+
+// Turns the touched documents among doc ids [begin, end) into final scores (cosine fused
+// with the PageRank prior) and appends those scoring above `threshold` to `out`
+typedef void (*FinalizeKernel)(const ScoreAccumulator &acc, const float *pagerank, size_t begin, size_t end, float threshold, ScoredDocs &out);
+
+inline void add_posting(ScoreAccumulator &acc, uint32_t doc, float weighted, float squared) {
+    if (acc.epochs[doc] != acc.epoch) {
+        acc.epochs[doc] = acc.epoch;
+        acc.dot_products[doc] = 0;
+        acc.magnitudes[doc] = 0;
+    }
+    acc.dot_products[doc] += weighted;
+    acc.magnitudes[doc] += squared;
+}
+
+// Postings are sorted by doc id, so the first and last entries bound the range
+inline void note_range(ScoreAccumulator &acc, const uint32_t *docs, size_t count) {
+    if (count == 0) return;
+    if (docs[0] < acc.min_doc) acc.min_doc = docs[0];
+    if (docs[count - 1] > acc.max_doc) acc.max_doc = docs[count - 1];
+}
+
+inline float fuse_score(float dot_product, float magnitude, float pagerank) {
+    float cosine = dot_product / std::sqrt(magnitude);
+    return pagerank > 0 ? COSINE_WEIGHT * cosine + PAGERANK_WEIGHT * pagerank : cosine;
+}
+
+// Used on every CPU: the updates are scattered by doc id, so vectorizing only the
+// multiplies was measured slower than this loop
+inline void accumulate_scalar(ScoreAccumulator &acc, const uint32_t *docs, const float *weights, size_t count, float query_weight) {
+    note_range(acc, docs, count);
+    for (size_t i = 0; i < count; ++i) {
+        add_posting(acc, docs[i], query_weight * weights[i], weights[i] * weights[i]);
+    }
+}
+
+inline void finalize_scalar(const ScoreAccumulator &acc, const float *pagerank, size_t begin, size_t end, float threshold, ScoredDocs &out) {
+    for (size_t doc = begin; doc < end; ++doc) {
+        if (acc.epochs[doc] != acc.epoch || !(acc.magnitudes[doc] > 0)) continue;
+        float score = fuse_score(acc.dot_products[doc], acc.magnitudes[doc], pagerank[doc]);
+        if (score > threshold) out.emplace_back((uint32_t)doc, score);
+    }
+}
+
+#ifdef SCORING_X86
+
+__attribute__((target("avx2")))
+inline void finalize_avx2(const ScoreAccumulator &acc, const float *pagerank, size_t begin, size_t end, float threshold, ScoredDocs &out) {
+    const __m256i epoch = _mm256_set1_epi32((int)acc.epoch);
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 limit = _mm256_set1_ps(threshold);
+    const __m256 cosine_weight = _mm256_set1_ps(COSINE_WEIGHT);
+    const __m256 pagerank_weight = _mm256_set1_ps(PAGERANK_WEIGHT);
+    alignas(32) float scores[8];
+
+    size_t doc = begin;
+    for (; doc + 8 <= end; doc += 8) {
+        __m256i tags = _mm256_loadu_si256((const __m256i *)(acc.epochs.data() + doc));
+        __m256 live = _mm256_castsi256_ps(_mm256_cmpeq_epi32(tags, epoch));
+        __m256 magnitude = _mm256_loadu_ps(acc.magnitudes.data() + doc);
+        live = _mm256_and_ps(live, _mm256_cmp_ps(magnitude, zero, _CMP_GT_OQ));
+        if (_mm256_movemask_ps(live) == 0) continue;
+
+        __m256 cosine = _mm256_div_ps(_mm256_loadu_ps(acc.dot_products.data() + doc), _mm256_sqrt_ps(magnitude));
+        __m256 prior = _mm256_loadu_ps(pagerank + doc);
+        __m256 fused = _mm256_add_ps(_mm256_mul_ps(cosine_weight, cosine), _mm256_mul_ps(pagerank_weight, prior));
+        __m256 score = _mm256_blendv_ps(cosine, fused, _mm256_cmp_ps(prior, zero, _CMP_GT_OQ));
+
+        int hits = _mm256_movemask_ps(_mm256_and_ps(live, _mm256_cmp_ps(score, limit, _CMP_GT_OQ)));
+        if (hits == 0) continue;
+        _mm256_store_ps(scores, score);
+        while (hits) {
+            int lane = __builtin_ctz(hits);
+            out.emplace_back((uint32_t)(doc + lane), scores[lane]);
+            hits &= hits - 1;
+        }
+    }
+    for (; doc < end; ++doc) {
+        if (acc.epochs[doc] != acc.epoch || !(acc.magnitudes[doc] > 0)) continue;
+        float score = fuse_score(acc.dot_products[doc], acc.magnitudes[doc], pagerank[doc]);
+        if (score > threshold) out.emplace_back((uint32_t)doc, score);
+    }
+}
+
+// SSE2 is part of the x86-64 baseline, so this is the fallback on CPUs without AVX2
+inline void finalize_sse2(const ScoreAccumulator &acc, const float *pagerank, size_t begin, size_t end, float threshold, ScoredDocs &out) {
+    const __m128i epoch = _mm_set1_epi32((int)acc.epoch);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 limit = _mm_set1_ps(threshold);
+    const __m128 cosine_weight = _mm_set1_ps(COSINE_WEIGHT);
+    const __m128 pagerank_weight = _mm_set1_ps(PAGERANK_WEIGHT);
+    alignas(16) float scores[4];
+
+    size_t doc = begin;
+    for (; doc + 4 <= end; doc += 4) {
+        __m128i tags = _mm_loadu_si128((const __m128i *)(acc.epochs.data() + doc));
+        __m128 live = _mm_castsi128_ps(_mm_cmpeq_epi32(tags, epoch));
+        __m128 magnitude = _mm_loadu_ps(acc.magnitudes.data() + doc);
+        live = _mm_and_ps(live, _mm_cmpgt_ps(magnitude, zero));
+        if (_mm_movemask_ps(live) == 0) continue;
+
+        __m128 cosine = _mm_div_ps(_mm_loadu_ps(acc.dot_products.data() + doc), _mm_sqrt_ps(magnitude));
+        __m128 prior = _mm_loadu_ps(pagerank + doc);
+        __m128 fused = _mm_add_ps(_mm_mul_ps(cosine_weight, cosine), _mm_mul_ps(pagerank_weight, prior));
+        __m128 has_prior = _mm_cmpgt_ps(prior, zero);
+        __m128 score = _mm_or_ps(_mm_and_ps(has_prior, fused), _mm_andnot_ps(has_prior, cosine));
+
+        int hits = _mm_movemask_ps(_mm_and_ps(live, _mm_cmpgt_ps(score, limit)));
+        if (hits == 0) continue;
+        _mm_store_ps(scores, score);
+        while (hits) {
+            int lane = __builtin_ctz(hits);
+            out.emplace_back((uint32_t)(doc + lane), scores[lane]);
+            hits &= hits - 1;
+        }
+    }
+    for (; doc < end; ++doc) {
+        if (acc.epochs[doc] != acc.epoch || !(acc.magnitudes[doc] > 0)) continue;
+        float score = fuse_score(acc.dot_products[doc], acc.magnitudes[doc], pagerank[doc]);
+        if (score > threshold) out.emplace_back((uint32_t)doc, score);
+    }
+}
+
+#endif
+
+// Kernels picked once at startup from what the CPU supports
+struct ScoringKernels {
+    AccumulateKernel accumulate;
+    FinalizeKernel finalize;
+    const char *name;
+
+    static const ScoringKernels &get() {
+        static const ScoringKernels kernels = select();
+        return kernels;
+    }
+
+private:
+    static ScoringKernels select() {
+#ifdef SCORING_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) {
+            return {accumulate_scalar, finalize_avx2, "avx2"};
+        }
+        if (__builtin_cpu_supports("sse2")) {
+            return {accumulate_scalar, finalize_sse2, "sse2"};
+        }
+#endif
+        return {accumulate_scalar, finalize_scalar, "scalar"};
+    }
+};
+
+#endif
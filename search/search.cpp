@@ -1,65 +1,228 @@
 #include <iostream>
 #include <algorithm>
 #include <vector>
-#include <sstream>
 #include <cmath>
 #include <regex>
+#include <memory>
+#include <string_view>
+#include <unordered_map>
+#include <memory_resource>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <csignal>
+#include <pthread.h>
 #include <curl/curl.h>
 #include <pybind11/embed.h>
+#include <pybind11/stl.h>
 #include <nlohmann/json.hpp>
 #include "structures/hashmap.hpp"
+#include "structures/lru_cache.hpp"
+#include "structures/snapshot.hpp"
+#include "structures/arena.hpp"
+#include "structures/tokenizer.hpp"
+#include "structures/stop_words.hpp"
+#include "structures/term_dictionary.hpp"
+#include "structures/completion_trie.hpp"
+#include "structures/spelling_index.hpp"
+#include "structures/trigram_index.hpp"
+#include "scoring.hpp"
 #include "crow.h"
 #include "crow/middlewares/cors.h"
 
 using json = nlohmann::json;
 
+//memory budget for cached /search responses
+#define RESULT_CACHE_BYTES (64 * 1024 * 1024)
+//doc ids scored per finalize pass; the top-k score bound is raised between passes
+#define FINALIZE_CHUNK_DOCS 4096
+//completions /suggest returns when the request doesn't say, and the most it returns
+#define DEFAULT_SUGGESTIONS 8
+#define MAX_SUGGESTIONS 50
+//unknown query terms up to this long are corrected by one edit at most, longer ones by two
+#define SHORT_TERM_LENGTH 4
+//terms a wildcard query term expands to at most, those in the most documents
+#define MAX_WILDCARD_EXPANSION 64
+//terms checked against a wildcard pattern at most, which bounds what one pattern costs
+#define MAX_WILDCARD_CANDIDATES 10000
+
 pybind11::scoped_interpreter guard{};
 pybind11::module lemmatizer = pybind11::module::import("lemmatizer");
-pybind11::object lemmatize_word = lemmatizer.attr("lemmatize_word");
-
-void read_pagerank(HashMap<std::string, double> &pagerankmap) {
+pybind11::object lemmatize_words = lemmatizer.attr("lemmatize_words");
+
+// One term's postings as parallel arrays sorted by doc id, so the scoring kernels can
+// stream through them
+struct PostingList {
+    std::vector<uint32_t> docs;
+    std::vector<float> weights;
+};
+
+// Everything a query is scored against. Built once, never modified after it is published.
+// Documents are numbered densely so per-query state can be kept in flat arrays, and terms
+// are numbered by the indexer's mapped term dictionary.
+struct IndexSnapshot {
+    TermDictionary terms;
+    std::vector<PostingList> postings; // term id -> postings
+    CompletionTrie completions;        // terms weighted by document frequency, for /suggest
+    SpellingIndex spelling;            // symmetric deletes of the terms, for correcting queries
+    TrigramIndex trigrams;             // trigrams of the terms, for wildcard queries
+    std::vector<std::string> urls;  // doc id -> url
+    std::vector<float> pagerank;    // doc id -> PageRank, 0 when unknown
+    uint64_t generation = 0;
+};
+
+SnapshotPublisher<IndexSnapshot> current_index;
+std::atomic<uint64_t> index_generation{0};
+std::atomic<bool> reload_in_progress{false};
+
+bool read_pagerank(IndexSnapshot &index, const HashMap<std::string, uint32_t> &doc_ids) {
     json temp_json;
 
     std::ifstream input_file("../jsonFiles/pagerank_output.json");
     if (!input_file) {
         std::cerr << "Error: Could not open file pagerank_output.json\n";
+        return false;
     }
     input_file >> temp_json;
 
+    index.pagerank.assign(index.urls.size(), 0);
     for (const auto &[url, rank] : temp_json.items()) {
-        pagerankmap[url] = rank;
+        // Only documents that have postings can ever be scored
+        const uint32_t *doc = doc_ids.find(url);
+        if (doc) index.pagerank[*doc] = rank.get<float>();
     }
+    return true;
 }
 
-void read_tfidf(HashMap<std::string, std::vector<std::pair<std::string, double>>> &tfidfmap) {
+bool read_tfidf(IndexSnapshot &index, HashMap<std::string, uint32_t> &doc_ids) {
     json temp_json;
-    
+
+    if (!index.terms.open("../jsonFiles/terms.dict")) {
+        std::cerr << "Error: Could not open term dictionary terms.dict\n";
+        return false;
+    }
+    index.postings.resize(index.terms.size());
+
     std::ifstream input_file("../jsonFiles/tfidf_output.json");
     if (!input_file.is_open()) {
         std::cerr << "Error: Could not open TF-IDF file\n";
-        return;
+        return false;
     }
 
     input_file >> temp_json;
 
     for (const auto &[key, value] : temp_json.items()) {
-        std::vector<std::pair<std::string, double>> vec;
+        uint64_t term_id = index.terms.find(key);
+        if (term_id == TermDictionary::npos) {
+            std::cerr << "Error: Term dictionary does not match the TF-IDF file\n";
+            return false;
+        }
+
+        std::vector<std::pair<uint32_t, float>> vec;
         for (auto &item : value) {
-            vec.emplace_back(item["url"], item["tfidf"]);
+            std::string url = item["url"];
+            const uint32_t *doc = doc_ids.find(url);
+            if (!doc) {
+                doc_ids.insert({url, (uint32_t)index.urls.size()});
+                index.urls.push_back(url);
+                doc = doc_ids.find(url);
+            }
+            vec.emplace_back(*doc, item["tfidf"].get<float>());
+        }
+        std::sort(vec.begin(), vec.end());
+
+        PostingList &list = index.postings[term_id];
+        list.docs.reserve(vec.size());
+        list.weights.reserve(vec.size());
+        for (const auto &[doc, weight] : vec) {
+            list.docs.push_back(doc);
+            list.weights.push_back(weight);
         }
-        tfidfmap[key] = vec;
     }
+    return true;
 }
 
+// Builds a fresh snapshot from the index files; returns nullptr if they cannot be read
+std::unique_ptr<IndexSnapshot> load_index() {
+    auto snapshot = std::make_unique<IndexSnapshot>();
+    try {
+        HashMap<std::string, uint32_t> doc_ids;
+        if (!read_tfidf(*snapshot, doc_ids) || !read_pagerank(*snapshot, doc_ids)) {
+            return nullptr;
+        }
+        // Searching works without it; /suggest just has nothing to offer
+        if (!snapshot->completions.open("../jsonFiles/completions.trie")) {
+            std::cerr << "Error: Could not open completion trie completions.trie\n";
+        }
+        // Without it, misspelled terms simply match nothing
+        if (!snapshot->spelling.open("../jsonFiles/spelling.sym")) {
+            std::cerr << "Error: Could not open spelling index spelling.sym\n";
+        }
+        // Without it, wildcard terms are matched against the dictionary directly
+        if (!snapshot->trigrams.open("../jsonFiles/trigrams.idx")) {
+            std::cerr << "Error: Could not open trigram index trigrams.idx\n";
+        }
+    } catch (const std::exception &e) {
+        std::cerr << "Error: Could not parse index files: " << e.what() << "\n";
+        return nullptr;
+    }
+
+    snapshot->generation = ++index_generation;
+    return snapshot;
+}
+
+// Loads the index off the request path and swaps it in. In-flight queries keep
+// scoring against the snapshot they started with.
+void reload_index(ShardedLRUCache<std::string, std::string> &result_cache) {
+    auto snapshot = load_index();
+    if (snapshot) {
+        uint64_t generation = snapshot->generation;
+        current_index.publish(std::move(snapshot));
+        result_cache.clear();
+        std::cout << "Index reloaded (generation " << generation << ")\n";
+    } else {
+        std::cerr << "Error: Index reload failed, keeping the current index\n";
+    }
+    reload_in_progress = false;
+}
+
+// Starts a background reload unless one is already running
+bool request_reload(ShardedLRUCache<std::string, std::string> &result_cache) {
+    bool expected = false;
+    if (!reload_in_progress.compare_exchange_strong(expected, true)) {
+        return false;
+    }
+
+    std::thread(reload_index, std::ref(result_cache)).detach();
+    return true;
+}
+
+// Lemmatizes every query word in a single Python call; this is the only part of a
+// request that needs the GIL. Wildcard patterns such as optim* are kept as typed.
 std::vector<std::string> split_query(std::string &query) {
+    // Same lowercase letter runs the crawler extracts keywords from
     std::vector<std::string> words;
-    std::istringstream ss(query);
-    std::string word;
+    AsciiTokenizer::local().forEachPattern(query, [&](std::string_view token, size_t) {
+        words.emplace_back(token);
+    });
 
-    pybind11::gil_scoped_acquire acquire;
-    while (ss >> word) {
-        words.push_back(lemmatize_word(word).cast<std::string>());
+    std::vector<std::string> plain;
+    for (const auto &word : words) {
+        if (!hasWildcard(word)) plain.push_back(word);
+    }
+    if (!plain.empty()) {
+        pybind11::gil_scoped_acquire acquire;
+        plain = lemmatize_words(plain).cast<std::vector<std::string>>();
+    }
+    auto lemma = plain.begin();
+    for (auto &word : words) {
+        if (!hasWildcard(word) && lemma != plain.end()) word = std::move(*lemma++);
     }
+    // The crawler never indexes stop words, so they could only ever be "corrected" into
+    // some unrelated term
+    words.erase(std::remove_if(words.begin(), words.end(), [](const std::string &word) {
+        return stopWords.count(word) > 0;
+    }), words.end());
     query.clear();
     
     for (const auto &keyword : words) {
@@ -69,12 +232,92 @@ std::vector<std::string> split_query(std::string &query) {
     return words;
 }
 
-HashMap<std::string, double> cosine_similarity(std::string &query, \
-    HashMap<std::string, std::vector<std::pair<std::string, double>>> &tfidfmap) {
-        pybind11::gil_scoped_acquire acquire;
-        std::vector<std::string> query_terms = split_query(query);
+// Rewrites every term the index doesn't know to the closest term it does: fewest edits
+// first, then the one in the most documents. Returns whether anything was rewritten. When
+// every term is known this costs one dictionary lookup per term. Wildcard terms are left
+// alone; stop words are already gone (see split_query).
+bool correct_query(const IndexSnapshot &index, std::vector<std::string> &query_terms) {
+    bool corrected = false;
+    for (auto &term : query_terms) {
+        if (hasWildcard(term) || index.terms.find(term) != TermDictionary::npos) continue;
+
+        size_t max_distance = term.size() <= SHORT_TERM_LENGTH ? 1 : SPELLING_MAX_DISTANCE;
+        std::string best;
+        size_t best_distance = max_distance + 1;
+        size_t best_documents = 0;
+        index.spelling.forEachCandidate(term, max_distance, [&](uint32_t term_id) {
+            std::string candidate = index.terms.term(term_id);
+            size_t distance = spellingDistance(term, candidate, max_distance);
+            if (distance > max_distance) return;
+
+            size_t documents = index.postings[term_id].docs.size();
+            if (distance < best_distance || (distance == best_distance && documents > best_documents)) {
+                best = std::move(candidate);
+                best_distance = distance;
+                best_documents = documents;
+            }
+        });
+
+        if (best_distance <= max_distance) {
+            term = std::move(best);
+            corrected = true;
+        }
+    }
+    return corrected;
+}
+
+// Ids of the terms matching a wildcard pattern, at most MAX_WILDCARD_EXPANSION of them,
+// those in the most documents first. The trigram index narrows the dictionary down to the
+// terms holding every trigram of the pattern; a pattern without one, like "a*", falls back
+// to the terms starting with its literal prefix, which may be all of them. Only the first
+// MAX_WILDCARD_CANDIDATES of those are checked against the pattern.
+std::vector<uint64_t> expand_wildcard(const IndexSnapshot &index, std::string_view pattern) {
+    std::vector<std::pair<size_t, uint64_t>> matches; // documents, term id
+    size_t checked = 0;
+    auto check = [&](std::string_view term, uint64_t term_id) {
+        if (wildcardMatch(pattern, term)) {
+            matches.emplace_back(index.postings[term_id].docs.size(), term_id);
+        }
+        return ++checked < MAX_WILDCARD_CANDIDATES;
+    };
+
+    static thread_local std::vector<uint32_t> candidates;
+    if (index.trigrams.candidates(pattern, candidates)) {
+        for (uint32_t term_id : candidates) {
+            if (!check(index.terms.term(term_id), term_id)) break;
+        }
+    } else {
+        index.terms.forEachWithPrefix(pattern.substr(0, pattern.find_first_of("*?")), check);
+    }
+
+    size_t kept = std::min<size_t>(matches.size(), MAX_WILDCARD_EXPANSION);
+    std::partial_sort(matches.begin(), matches.begin() + kept, matches.end(), std::greater<>());
+    std::vector<uint64_t> term_ids;
+    for (size_t i = 0; i < kept; i++) {
+        term_ids.push_back(matches[i].second);
+    }
+    return term_ids;
+}
+
+// Order-independent form of the lemmatized query, used as the result cache key
+std::string normalize_query(std::vector<std::string> terms, size_t k, size_t offset) {
+    std::sort(terms.begin(), terms.end());
+
+    std::string key;
+    for (const auto &term : terms) {
+        key += term + " ";
+    }
+    key += "|" + std::to_string(k) + "|" + std::to_string(offset);
 
-        std::unordered_map<std::string, double> query_vector;
+    return key;
+}
+
+// Term-at-a-time scoring into the thread's dense accumulator, then vectorized passes that
+// fuse cosine similarity with the PageRank prior for every touched document. When only the
+// best `wanted` results are needed (0 means all), those passes keep just the documents
+// scoring above the wanted-th best score so far.
+ScoredDocs cosine_similarity(const std::vector<std::string> &query_terms, const IndexSnapshot &index, std::pmr::memory_resource *arena, size_t wanted) {
+        std::pmr::unordered_map<std::string_view, double> query_vector(arena);
         for (const auto &term : query_terms) {
             query_vector[term] += 1.0;
         }
@@ -89,63 +332,105 @@ HashMap<std::string, double> cosine_similarity(std::string &query, \
             frequency /= query_magnitude;
         }
 
-        HashMap<std::string, double> doc_vector_magnitudes;
-        HashMap<std::string, double> dot_products;
+        const ScoringKernels &kernels = ScoringKernels::get();
+        ScoreAccumulator &accumulator = ScoreAccumulator::local();
+        accumulator.begin_query(index.urls.size());
 
+        auto accumulate = [&](uint64_t term_id, double query_weight) {
+            const PostingList &postings = index.postings[term_id];
+            kernels.accumulate(accumulator, postings.docs.data(), postings.weights.data(), postings.docs.size(), (float)query_weight);
+        };
         for (const auto &[term, query_weight] : query_vector) {
-            if (tfidfmap.count(term) > 0) {
-                for (const auto &[doc_id, tfidf_value] : tfidfmap.at(term)) {
-                    dot_products[doc_id] += query_weight * tfidf_value;
-                    doc_vector_magnitudes[doc_id] += tfidf_value * tfidf_value;
+            // A wildcard term counts as one query term, scored over the union of the
+            // postings of the terms it expands to
+            if (hasWildcard(term)) {
+                for (uint64_t term_id : expand_wildcard(index, term)) {
+                    accumulate(term_id, query_weight);
                 }
+                continue;
+            }
+            uint64_t term_id = index.terms.find(term);
+            if (term_id != TermDictionary::npos) {
+                accumulate(term_id, query_weight);
             }
         }
 
-        HashMap<std::string, double> cosine_similarities;
-        for (const auto &[doc_id, dot_product] : dot_products) {
-            double doc_magnitude = std::sqrt(doc_vector_magnitudes[doc_id]);
-            if (doc_magnitude > 0)
-                cosine_similarities[doc_id] = dot_product / doc_magnitude;
+        // Once twice `wanted` scores have piled up, the best `wanted` are kept and the worst of
+        // them becomes the bound for the passes after
+        ScoredDocs scores(arena);
+        float threshold = -std::numeric_limits<float>::infinity();
+        for (size_t begin = accumulator.min_doc; begin <= accumulator.max_doc; begin += FINALIZE_CHUNK_DOCS) {
+            size_t end = std::min<size_t>(begin + FINALIZE_CHUNK_DOCS, (size_t)accumulator.max_doc + 1);
+            kernels.finalize(accumulator, index.pagerank.data(), begin, end, threshold, scores);
+            if (wanted > 0 && scores.size() >= 2 * wanted) {
+                std::nth_element(scores.begin(), scores.begin() + wanted - 1, scores.end(),
+                                 [](const std::pair<uint32_t, float> &a, const std::pair<uint32_t, float> &b) {
+                                     return a.second > b.second;
+                                 });
+                scores.resize(wanted);
+                threshold = scores[wanted - 1].second;
+            }
         }
-
-        return cosine_similarities;
+        return scores;
 }
 
-std::vector<std::pair<std::string, double>> get_results(HashMap<std::string, double> sim, HashMap<std::string, double> &pagerankmap) {
-    std::vector<std::pair<std::string, double>> results;
-    for (const auto &[url, cs] : sim) {
-        results.push_back({url, cs});
-    }
-
-    //{{url1, cs1}, {url2, cs2}, ...}
-    for (auto &[url, cs] : results) {
-        double pageranking = *pagerankmap.find(url);
-        if (!pageranking) continue;
-        cs = 0.7 * cs + 0.3 * (pageranking);
-    }
+// Returns the urls ranked offset .. offset + k (k = 0 means all), best first. Only that
+// prefix of the results is sorted.
+std::vector<std::string> order_results(ScoredDocs &unordered_results, const IndexSnapshot &index, size_t k, size_t offset) {
+    if (offset >= unordered_results.size()) return {};
 
-    return results;
-}
-
-std::vector<std::string> order_results(std::vector<std::pair<std::string, double>> unordered_results) {
+    size_t end = (k > 0 && k < unordered_results.size() - offset) ? offset + k : unordered_results.size();
     // Sort the vector in descending order based on the double value in the pair
-    std::sort(unordered_results.begin(), unordered_results.end(), 
-              [](const std::pair<std::string, double>& a, const std::pair<std::string, double>& b) {
+    std::partial_sort(unordered_results.begin(), unordered_results.begin() + end, unordered_results.end(),
+              [](const std::pair<uint32_t, float>& a, const std::pair<uint32_t, float>& b) {
                   return a.second > b.second; // Compare the second element of the pairs
               });
-    
+
     // Create a vector to store the ordered strings
     std::vector<std::string> ordered_strings;
-    ordered_strings.reserve(unordered_results.size()); // Reserve space for efficiency
+    ordered_strings.reserve(end - offset); // Reserve space for efficiency
 
     // Extract the strings from the sorted pairs
-    for (const auto& pair : unordered_results) {
-        ordered_strings.push_back(pair.first);
+    for (size_t i = offset; i < end; ++i) {
+        ordered_strings.push_back(index.urls[unordered_results[i].first]);
     }
 
     return ordered_strings;
 }
 
+// Scores, ranks and pages the results for already lemmatized query terms. Touches only
+// the immutable snapshot, so any number of request threads can run it at once.
+// Intermediate scoring state lives in the thread's request arena, which is reset on return.
+std::vector<std::string> search_index(const IndexSnapshot &index, const std::vector<std::string> &query_terms, size_t k, size_t offset) {
+    RequestArena::Scope arena;
+
+    size_t wanted = (k > 0 && k <= SIZE_MAX - offset) ? offset + k : 0;
+    ScoredDocs sim = cosine_similarity(query_terms, index, arena.resource(), wanted);
+    return order_results(sim, index, k, offset);
+}
+
+// Completes the last word of what the user has typed so far. Only that word is looked up,
+// unlemmatized since it is unfinished; the rest of the text is kept as typed.
+json suggest(const IndexSnapshot &index, std::string text, size_t k) {
+    std::transform(text.begin(), text.end(), text.begin(), [](char c) {
+        return tolower(c);
+    });
+
+    size_t start = text.size();
+    while (start > 0 && text[start - 1] >= 'a' && text[start - 1] <= 'z') --start;
+    std::string_view prefix = std::string_view(text).substr(start);
+
+    json response = json::array();
+    if (prefix.empty()) return response;
+
+    std::vector<std::pair<std::string, float>> completions;
+    index.completions.complete(prefix, k, completions);
+    for (const auto &[term, documents] : completions) {
+        response.push_back({{"query", text.substr(0, start) + term}, {"term", term}, {"documents", documents}});
+    }
+    return response;
+}
+
 // Callback function for writing data received by libcurl
 size_t WriteCallback(void* contents, size_t size, size_t nmemb, std::string* userData) {
     size_t totalSize = size * nmemb;
@@ -198,33 +483,255 @@ HashMap<std::string, std::pair<std::string, std::string>> get_title_and_desc(std
     return res;
 }
 
-int main() {
+// Measures /search throughput for 1, 2, 4 ... max_threads threads over the queries in
+// queries_file (one per line). By default queries are lemmatized up front and only
+// scoring, ranking and serialization are timed, the GIL-free part. With `pipeline` every
+// iteration also lemmatizes and corrects its query, so the one GIL-bound stage is in the
+// numbers too. Fetching titles and descriptions is left out either way: it measures the
+// remote sites, not this server.
+void run_benchmark(const std::string &queries_file, unsigned max_threads, double seconds, bool pipeline) {
+    std::ifstream input_file(queries_file);
+    if (!input_file.is_open()) {
+        std::cerr << "Error: Could not open " << queries_file << "\n";
+        return;
+    }
+
+    std::vector<std::string> lines;
+    std::vector<std::vector<std::string>> queries;
+    std::string line;
+    while (std::getline(input_file, line)) {
+        std::transform(line.begin(), line.end(), line.begin(), [](char c) {
+            return tolower(c);
+        });
+        std::string text = line;
+        std::vector<std::string> terms = split_query(text);
+        if (!terms.empty()) {
+            lines.push_back(line);
+            queries.push_back(terms);
+        }
+    }
+    if (queries.empty()) {
+        std::cerr << "Error: No queries in " << queries_file << "\n";
+        return;
+    }
+
+    pybind11::gil_scoped_release release;
+    double single_thread_qps = 0;
+    std::cout << "threads\tqueries/s\tspeedup\n";
+
+    // Doubling, with max_threads itself always the last step
+    for (unsigned threads = 1;; threads = std::min(threads * 2, max_threads)) {
+        std::atomic<bool> stop{false};
+        std::atomic<uint64_t> completed{0};
+        std::vector<std::thread> workers;
+
+        for (unsigned t = 0; t < threads; ++t) {
+            workers.emplace_back([&, t]() {
+                uint64_t done = 0;
+                for (size_t i = t; !stop.load(std::memory_order_relaxed); ++i) {
+                    std::vector<std::string> terms;
+                    if (pipeline) {
+                        std::string text = lines[i % lines.size()];
+                        terms = split_query(text);
+                    }
+                    auto index = current_index.read();
+                    if (pipeline) correct_query(*index, terms);
+                    std::vector<std::string> urls = search_index(*index, pipeline ? terms : queries[i % queries.size()], 10, 0);
+                    json response = urls;
+                    std::string serialized = response.dump();
+                    ++done;
+                }
+                completed += done;
+            });
+        }
+
+        std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+        stop = true;
+        for (auto &worker : workers) worker.join();
+
+        double qps = completed / seconds;
+        if (threads == 1) single_thread_qps = qps;
+        std::cout << threads << "\t" << qps << "\t" << (single_thread_qps > 0 ? qps / single_thread_qps : 0) << "\n";
+        if (threads >= max_threads) break;
+    }
+}
+
+// Checks split_query on queries it has got wrong before; needs the lemmatizer but no index
+bool run_self_test() {
+    struct Case {
+        std::string query;
+        std::vector<std::string> expected;
+    };
+    std::vector<Case> cases = {
+        {"how does pagerank work?", {"pagerank", "work"}}, // a trailing '?' is punctuation
+        {"work ?", {"work"}},                              // and so is a standalone one
+        {"optim* c?t", {"optim*", "c?t"}},                 // '*' and an inner '?' make patterns
+        {"what is this?", {}},                             // nothing but stop words
+    };
+
+    bool passed = true;
+    for (const auto &test : cases) {
+        std::string query = test.query;
+        std::vector<std::string> terms = split_query(query);
+        if (terms != test.expected) {
+            std::cerr << "FAIL split_query(\"" << test.query << "\"):";
+            for (const auto &term : terms) std::cerr << " " << term;
+            std::cerr << "\n";
+            passed = false;
+        }
+    }
+    std::cout << (passed ? "self-test passed\n" : "self-test failed\n");
+    return passed;
+}
+
+int main(int argc, char *argv[]) {
     crow::App<crow::CORSHandler> app;
-    
-    HashMap<std::string, std::vector<std::pair<std::string, double>>> tfidfmap;
-    read_tfidf(tfidfmap);
 
-    HashMap<std::string, double> pagerankmap;
-    read_pagerank(pagerankmap);
+    // ./search --self-test
+    if (argc >= 2 && std::string(argv[1]) == "--self-test") {
+        return run_self_test() ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    auto initial_index = load_index();
+    if (!initial_index) {
+        return EXIT_FAILURE;
+    }
+    current_index.publish(std::move(initial_index));
+
+    // ./search --bench <queries file> [max threads] [seconds per step]
+    // ./search --bench-pipeline ... the same, lemmatizing every query as it is searched
+    if (argc >= 3 && (std::string(argv[1]) == "--bench" || std::string(argv[1]) == "--bench-pipeline")) {
+        unsigned max_threads = argc >= 4 ? std::stoul(argv[3]) : std::thread::hardware_concurrency();
+        double seconds = argc >= 5 ? std::stod(argv[4]) : 5.0;
+        run_benchmark(argv[2], max_threads ? max_threads : 1, seconds, std::string(argv[1]) == "--bench-pipeline");
+        return EXIT_SUCCESS;
+    }
+
+    // Serialized responses keyed by normalized query + k/offset
+    ShardedLRUCache<std::string, std::string> result_cache(RESULT_CACHE_BYTES);
+
+    // SIGHUP triggers a reload. It is blocked here, before any worker thread exists,
+    // so only the waiting thread below ever receives it.
+    sigset_t reload_signals;
+    sigemptyset(&reload_signals);
+    sigaddset(&reload_signals, SIGHUP);
+    pthread_sigmask(SIG_BLOCK, &reload_signals, nullptr);
+    std::thread([&result_cache, reload_signals]() {
+        int signal_number;
+        while (sigwait(&reload_signals, &signal_number) == 0) {
+            request_reload(result_cache);
+        }
+    }).detach();
 
     CROW_ROUTE(app, "/search").methods("POST"_method)([&](const crow::request &req) {
         auto body = json::parse(req.body);
         std::string query = body["query"];
+        // k = 0 returns every match. Non-negative integers only; JSON parses those as unsigned.
+        for (const char *field : {"k", "offset"}) {
+            if (body.contains(field) && !body[field].is_number_unsigned()) {
+                return crow::response(400, std::string(field) + " must be a non-negative integer");
+            }
+        }
+        uint64_t k = body.value("k", uint64_t(0));
+        uint64_t offset = body.value("offset", uint64_t(0));
         std::transform(query.begin(), query.end(), query.begin(), [](char c) {
             return tolower(c);
         });
 
-        HashMap<std::string, double> sim = cosine_similarity(query, tfidfmap);
-        auto results = get_results(sim, pagerankmap);
+        std::vector<std::string> query_terms = split_query(query);
+        auto index = current_index.read();
+        // There are never more results than documents, so larger values add no cache keys
+        k = std::min<uint64_t>(k, index->urls.size());
+        offset = std::min<uint64_t>(offset, index->urls.size());
+        bool corrected = correct_query(*index, query_terms);
+        std::string cache_key = normalize_query(query_terms, k, offset) + "|" + std::to_string(index->generation);
+
+        // A corrected query is searched as corrected; the terms used go back in a header
+        auto respond = [&](const std::string &body) {
+            crow::response res(body);
+            if (corrected) {
+                std::string corrected_query;
+                for (const auto &term : query_terms) {
+                    corrected_query += (corrected_query.empty() ? "" : " ") + term;
+                }
+                res.add_header("X-Corrected-Query", corrected_query);
+                res.add_header("Access-Control-Expose-Headers", "X-Corrected-Query");
+            }
+            return res;
+        };
+
+        std::string cached;
+        if (result_cache.get(cache_key, cached)) {
+            return respond(cached);
+        }
 
-        std::vector<std::string> final_result = order_results(results);
+        std::vector<std::string> final_result = search_index(*index, query_terms, k, offset);
+        uint64_t generation = index->generation;
+        // The urls are copies, so a slow title fetch below doesn't hold up a pending publish()
+        index.release();
         HashMap<std::string, std::pair<std::string, std::string>> full_result = get_title_and_desc(final_result);
 
-        json response;
+        json response = json::array();
         for (const auto &url : final_result) {
             response.push_back({{"title", full_result.find(url)->first}, {"URL", url}, {"description", full_result.find(url)->second}});
         }
 
+        std::string serialized = response.dump();
+        // A reload since the search has already cleared the cache, and nothing asks for the old generation's keys
+        if (current_index.read()->generation == generation) {
+            result_cache.put(cache_key, serialized, cache_key.size() + serialized.size());
+        }
+        return respond(serialized);
+    });
+
+    // GET /suggest?q=<text typed so far>&k=<number of completions>
+    CROW_ROUTE(app, "/suggest")([&](const crow::request &req) {
+        const char *text = req.url_params.get("q");
+        const char *count = req.url_params.get("k");
+        size_t k = count ? std::min<size_t>(std::strtoul(count, nullptr, 10), MAX_SUGGESTIONS) : DEFAULT_SUGGESTIONS;
+
+        auto index = current_index.read();
+        return crow::response(suggest(*index, text ? text : "", k).dump());
+    });
+
+    CROW_ROUTE(app, "/admin/reload").methods("POST"_method)([&](const crow::request &) {
+        if (!request_reload(result_cache)) {
+            return crow::response(409, "Reload already in progress");
+        }
+        return crow::response(202, "Reload started");
+    });
+
+    CROW_ROUTE(app, "/stats")([&]() {
+        auto stats = result_cache.stats();
+        json response;
+        response["cache"] = {
+            {"hits", stats.hits},
+            {"misses", stats.misses},
+            {"hit_ratio", stats.hitRatio()},
+            {"insertions", stats.insertions},
+            {"evictions", stats.evictions},
+            {"rejections", stats.rejections},
+            {"entries", stats.entries},
+            {"bytes", stats.bytes},
+            {"capacity_bytes", stats.capacityBytes}
+        };
+        response["arena"] = {
+            {"resets", RequestArena::resets().load()},
+            {"heap_allocations", RequestArena::overflow().allocations.load()},
+            {"heap_bytes", RequestArena::overflow().allocatedBytes.load()}
+        };
+        auto index = current_index.read();
+        response["index"] = {
+            {"generation", index->generation},
+            {"terms", index->terms.size()},
+            {"dictionary_bytes", index->terms.bytes()},
+            {"completion_trie_bytes", index->completions.bytes()},
+            {"spelling_index_bytes", index->spelling.bytes()},
+            {"trigram_index_bytes", index->trigrams.bytes()},
+            {"scoring_kernels", ScoringKernels::get().name},
+            {"reload_in_progress", reload_in_progress.load()}
+        };
+
         return crow::response(response.dump());
     });
 